@@ -0,0 +1,45 @@
+#version 330
+
+uniform mat4 view_matrix;
+uniform mat4 proj_matrix;
+uniform mat4 normal_matrix;
+
+// quantization box of the positions, set by ClothRenderer::Draw()
+uniform vec3 position_lower;
+uniform vec3 position_extent;
+
+layout(location = 0) in vec4 vertex;
+layout(location = 1) in vec2 normal;
+layout(location = 2) in vec2 tangent;
+layout(location = 3) in vec2 tex_coord;
+
+out vec3 position_in_world_space;
+out vec3 normal_in_world_space;
+out vec3 tangent_in_world_space;
+out mat3 TBN;
+out vec2 uv;
+
+// Inverse of the octahedral encoding in include/vertex_formats.h
+vec3 octahedralDecode(vec2 e) {
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0) {
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(v);
+}
+
+void main() {
+    uv = tex_coord.xy;
+    vec3 position = position_lower + vertex.xyz * position_extent;
+    position_in_world_space = position;
+    vec3 N = octahedralDecode(normal);
+    vec3 T = octahedralDecode(tangent);
+    normal_in_world_space = N;
+    tangent_in_world_space = T;
+    // Gram-Schmidt re-orthogonalization
+    T = normalize(T - dot(T, N) * N);
+    vec3 B = cross(N, T);
+    TBN = mat3(T, B, N);
+
+    gl_Position = proj_matrix * view_matrix * vec4(position, 1);
+}
@@ -0,0 +1,72 @@
+#version 330
+
+uniform mat4 view_matrix;
+uniform mat4 proj_matrix;
+uniform mat4 normal_matrix;
+
+// the cloth's positions and grid size, set by ClothRenderer
+uniform samplerBuffer positions;
+uniform int num_ropes;
+uniform int points_per_rope;
+
+layout(location = 3) in vec2 tex_coord;
+
+out vec3 position_in_world_space;
+out vec3 normal_in_world_space;
+out vec3 tangent_in_world_space;
+out mat3 TBN;
+out vec2 uv;
+
+vec3 point(int j, int i) {
+    return texelFetch(positions, j * points_per_rope + i).xyz;
+}
+
+void main() {
+    int j = gl_VertexID / points_per_rope;
+    int i = gl_VertexID - j * points_per_rope;
+    vec3 p = point(j, i);
+
+    // Sum the area weighted normals and the tangents of the up to six triangles around the
+    // point, the same triangles as gridShadingRun() in include/force_kernels.h
+    vec3 normal = vec3(0.0);
+    vec3 tangent = vec3(0.0);
+    if (j > 0) {
+        vec3 prev = point(j - 1, i);
+        if (i > 0) {
+            normal += cross(p - prev, point(j, i - 1) - prev);
+            tangent += p - prev;
+        }
+        if (i < points_per_rope - 1) {
+            vec3 prev_after = point(j - 1, i + 1);
+            vec3 after = point(j, i + 1);
+            normal += cross(prev_after - prev, p - prev) + cross(after - prev_after, p - prev_after);
+            tangent += (p - prev) + (after - prev_after);
+        }
+    }
+    if (j < num_ropes - 1) {
+        vec3 next = point(j + 1, i);
+        if (i > 0) {
+            vec3 before = point(j, i - 1);
+            vec3 next_before = point(j + 1, i - 1);
+            normal += cross(p - before, next_before - before) + cross(next - p, next_before - p);
+            tangent += (next_before - before) + (next - p);
+        }
+        if (i < points_per_rope - 1) {
+            normal += cross(point(j, i + 1) - p, next - p);
+            tangent += next - p;
+        }
+    }
+
+    uv = tex_coord.xy;
+    position_in_world_space = p;
+    vec3 N = normalize(normal);
+    vec3 T = normalize(tangent);
+    normal_in_world_space = N;
+    tangent_in_world_space = T;
+    // Gram-Schmidt re-orthogonalization
+    T = normalize(T - dot(T, N) * N);
+    vec3 B = cross(N, T);
+    TBN = mat3(T, B, N);
+
+    gl_Position = proj_matrix * view_matrix * vec4(p, 1);
+}
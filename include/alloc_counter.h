@@ -0,0 +1,18 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstddef>
+
+/**
+ * Total number of heap allocations made through the global operator new since the
+ * program started. Counting is only compiled in when the library is configured with
+ * CLOTHSIM_COUNT_ALLOCATIONS=ON, otherwise this always returns 0.
+ */
+size_t HeapAllocationCount();
+
+/**
+ * Count an allocation that bypasses operator new, such as the aligned particle lanes.
+ */
+void RecordHeapAllocation();
+
+#endif  // ALLOC_COUNTER_H
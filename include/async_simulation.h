@@ -0,0 +1,65 @@
+#ifndef ASYNC_SIMULATION_H
+#define ASYNC_SIMULATION_H
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <glm/glm.hpp>
+
+#include "cloth.h"
+
+/**
+ * Runs a Cloth on a thread of its own, so the simulation overlaps the rendering instead of adding
+ * to the frame time, and a frame waiting for vsync does not hold up the simulation.
+ * The simulation thread calls Cloth::Advance(frame_dt) up to frames_per_second times a second and
+ * publishes the positions after every frame through a triple buffer: it fills its own slot, then
+ * swaps it with the shared slot in a single atomic exchange. Acquire() swaps the shared slot with
+ * the reader's slot the same way when a newer frame was published, so neither side ever waits for
+ * the other and the reader always gets the latest complete frame.
+ * The simulated cloth must not be used by other threads while the simulation runs, the render
+ * thread draws a second cloth built the same way that mirrors it, see Acquire().
+ */
+class AsyncSimulation {
+public:
+	// A frames_per_second of 0 simulates as fast as possible. The simulation starts paused.
+	AsyncSimulation(Cloth &cloth, float frame_dt, float frames_per_second);
+
+	~AsyncSimulation();
+
+	AsyncSimulation(const AsyncSimulation&) = delete;
+	AsyncSimulation& operator=(const AsyncSimulation&) = delete;
+
+	void SetPaused(bool paused) { paused_.store(paused, std::memory_order_relaxed); }
+	bool GetPaused() const { return paused_.load(std::memory_order_relaxed); }
+
+	bool Acquire(Cloth &display);
+
+	// Frames simulated so far
+	unsigned long FrameCount() const { return frame_count_.load(std::memory_order_relaxed); }
+
+private:
+	// the shared slot index, with kFresh set while it holds a frame Acquire() has not taken yet
+	static const int kFresh = 4;
+	static const int kSlotMask = 3;
+
+	Cloth &cloth_;
+	float frame_dt_;
+	std::chrono::steady_clock::duration period_;
+
+	glm::vec3 *slots_[3];
+	// written by the simulation thread, read by Acquire(), exchanged between them
+	int back_;
+	int front_;
+	std::atomic<int> shared_;
+
+	std::atomic<bool> paused_;
+	std::atomic<bool> stop_;
+	std::atomic<unsigned long> frame_count_;
+	std::thread thread_;
+
+	void run();
+	void publish();
+};
+
+#endif  // ASYNC_SIMULATION_H
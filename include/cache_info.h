@@ -0,0 +1,21 @@
+#ifndef CACHE_INFO_H
+#define CACHE_INFO_H
+
+#include <cstddef>
+
+/**
+ * Data cache sizes of the CPU we are running on, in bytes. A level that could not be queried
+ * is 0.
+ */
+struct CacheSizes {
+	size_t l1d = 0;
+	size_t l2 = 0;
+	size_t l3 = 0;
+};
+
+/**
+ * Query the cache sizes once, later calls return the same result.
+ */
+const CacheSizes& DetectCacheSizes();
+
+#endif  // CACHE_INFO_H
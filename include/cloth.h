@@ -1,24 +1,173 @@
-#include <string>
+#ifndef CLOTH_H
+#define CLOTH_H
+
+#include <cstddef>
+#include <memory>
 
 #include <glm/glm.hpp>
-#include <glad/glad.h>
 
+#include "cloth_workspace.h"
+#include "implicit_solver.h"
+#include "particle_store.h"
+#include "projective_solver.h"
+#include "sleep_tracker.h"
+#include "spring_kernels.h"
+#include "spring_list.h"
+#include "thread_pool.h"
+#include "vertex_formats.h"
+#include "xpbd_solver.h"
+
+struct ForceParams;
+struct GatherScratch;
+
+/**
+ * Bookkeeping about the most recent call to Cloth::Update().
+ */
+struct ClothStats {
+	// Heap allocations made during the step, only tracked with CLOTHSIM_COUNT_ALLOCATIONS
+	size_t step_allocations = 0;
+	// Iterations of Integrator::BackwardEuler, Integrator::XPBD or
+	// Integrator::ProjectiveDynamics, and the final relative residual of the first
+	int solver_iterations = 0;
+	float solver_residual = 0.0f;
+	// Set by Cloth::Advance(): the number and length of the substeps taken for the frame, and
+	// the stable timestep they were derived from
+	int substeps = 1;
+	float substep_dt = 0.0f;
+	float stable_dt = 0.0f;
+	// Tiles simulated by the last step and all tiles, with Cloth::SetSleeping()
+	int awake_tiles = 0;
+	int total_tiles = 0;
+};
+
+/**
+ * How Cloth evaluates its spring and drag forces.
+ * Scatter evaluates every spring once and adds the result to both of its points, the passes are
+ * colored so the threads never write to the same rope.
+ * Gather computes each rope's forces from all of its springs and drag triangles, springs between
+ * ropes are evaluated twice but every rope is independent, so there is no synchronization.
+ * Fused gathers the forces like Gather and integrates each rope as soon as its neighbors no longer
+ * need its old state, so every half step streams the positions and velocities only once.
+ */
+enum class ForceMode {
+	Scatter,
+	Gather,
+	Fused
+};
+
+/**
+ * How Cloth::Update() advances the simulation.
+ * ImprovedEuler is the explicit two stage method, cheap per step but only stable with soft
+ * springs or small timesteps.
+ * BackwardEuler takes one linearized implicit step, see ImplicitSolver. A step costs a few
+ * conjugate gradient iterations but stays stable for stiff springs at large timesteps.
+ * XPBD treats the springs as compliant distance constraints, see XpbdSolver. A step costs a
+ * fixed number of sweeps over the springs, whatever the stiffness.
+ * ProjectiveDynamics alternates projecting the springs onto their rest length with a global
+ * solve whose matrix is factored once, see ProjectiveSolver.
+ * SymplecticEuler, PositionVerlet and VelocityVerlet evaluate the forces once per step instead
+ * of twice like ImprovedEuler, and being symplectic their energy error stays bounded for
+ * undamped cloth instead of drifting. SymplecticEuler updates the velocities and then the
+ * positions with them, PositionVerlet evaluates the forces half way through a drift of the
+ * positions, VelocityVerlet keeps the forces at the end of one step for the first half kick of
+ * the next one.
+ */
+enum class Integrator {
+	ImprovedEuler,
+	BackwardEuler,
+	XPBD,
+	ProjectiveDynamics,
+	SymplecticEuler,
+	PositionVerlet,
+	VelocityVerlet
+};
+
+/**
+ * Mass-spring cloth simulation. This class only owns the simulation state and the
+ * shading attributes derived from it, it does not make any OpenGL calls. Use a
+ * ClothRenderer to draw it. GridCloth derives from it to replace the force and normal
+ * passes with versions specialized for a fixed grid size, MeshCloth to simulate an arbitrary
+ * triangle mesh instead of a grid.
+ */
 class Cloth {
 public:
 	Cloth(int num_ropes, int num_columns, float k, float kv, float mass,
-		float rest_length, float drag_coef, float start_x, float start_y, float z_val);
+		float rest_length, float drag_coef, float start_x, float start_y, float z_val,
+		ForceMode force_mode = ForceMode::Scatter);
 
-	~Cloth();
+	virtual ~Cloth();
 
-	void initGL(GLuint shader);
-	
 	void LockNode(int x, int y, bool skip);
+	void LockPoint(int index, bool skip);
 
 	void Update(float dt);
+	void Advance(float frame_dt);
+	float StableTimestep();
+	void SetMaxSubsteps(int max_substeps) { max_substeps_ = max_substeps; }
+	int GetMaxSubsteps() const { return max_substeps_; }
+
+	void SetSimdLevel(SimdLevel level);
+	SimdLevel GetSimdLevel() const { return simd_level_; }
+
+	void SetThreadCount(int num_threads);
+	int GetThreadCount() const { return pool_->NumThreads(); }
+
+	void SetTileSize(int num_points);
+	int GetTileSize() const { return tile_size_; }
+
+	void SetIntegrator(Integrator integrator);
+	Integrator GetIntegrator() const { return integrator_; }
+	void SetSolverTolerance(float tolerance, int max_iterations);
+	void SetConstraintIterations(int num_iterations);
+
+	void SetSleeping(bool enabled);
+	bool GetSleeping() const { return sleeping_; }
+	void SetSleepThresholds(float kinetic_energy, float force);
 
-	void Draw();
+	int NumPoints() const { return num_pts_; }
+	int NumTriangles() const { return num_tris_; }
+	int NumRopes() const { return num_ropes_; }
+	int PointsPerRope() const { return pts_per_rope_; }
 
-private:
+	const glm::vec3* Positions() const { return cloth_pts_; }
+	void SetPositions(const glm::vec3 *positions);
+	glm::vec3 Velocity(int i) const { return vel_.Lanes().Get(i); }
+	// The normals and tangents are computed on demand, see UpdateShading()
+	const glm::vec3* Normals() const { UpdateShading(false); return norms_; }
+	const glm::vec3* Tangents() const { UpdateShading(true); return tans_; }
+	const glm::vec2* UVs() const { return uvs_; }
+	const unsigned int* Indices() const { return indices_; }
+	void WriteVertices(RenderVertex *vertices, int first, int last) const;
+	void WriteVertices(CompactVertex *vertices, int first, int last, const glm::vec3 &box_lower,
+		const glm::vec3 &box_extent) const;
+	void WriteVertices(RenderVertexNoTangent *vertices, int first, int last) const;
+	void WriteVertices(CompactVertexNoTangent *vertices, int first, int last, const glm::vec3 &box_lower,
+		const glm::vec3 &box_extent) const;
+	void UpdateShading(bool tangents = true) const;
+	// Bounding box of the positions after the last step
+	void Bounds(glm::vec3 *lower, glm::vec3 *upper) const;
+
+	const ClothStats& Stats() const { return stats_; }
+
+	/**
+	 * Change tracking for incremental uploads. The points are grouped into blocks of consecutive
+	 * points, block b holds the points [BlockStart(b), BlockStart(b + 1)). A grid cloth splits
+	 * every rope into segments the height of a sleep tile, a MeshCloth is a single block.
+	 * BlockChangeStep(b) is the StepCount() of the last step that moved a point of block b or
+	 * changed its normals and tangents.
+	 */
+	unsigned long StepCount() const { return step_count_; }
+	int NumChangeBlocks() const { return num_change_blocks_; }
+	int BlockStart(int block) const { return block_start_[block]; }
+	unsigned long BlockChangeStep(int block) const { return block_change_step_[block]; }
+
+	// Kinetic plus spring and gravity potential energy, to measure the energy drift of an
+	// integrator
+	double Energy();
+
+protected:
+	Cloth(const glm::vec3 *points, const glm::vec2 *uvs, int num_pts, const unsigned int *indices, int num_tris,
+		float k, float kv, float mass, float drag_coef);
 
 	int pts_per_rope_;
 	int num_ropes_;
@@ -31,28 +180,91 @@ private:
 	float drag_coef_;
 
 	glm::vec3 air_res_;
-	glm::vec3 *cloth_pts_;
-	glm::vec3 *vels_;
-	glm::vec3 *accels_;
+	// Solver state, stored as aligned structure-of-arrays lanes
+	Vec3LaneBuffer pos_;
+	Vec3LaneBuffer vel_;
+	float *inv_mass_;
 
 	bool *lock_;
 
+	// Positions converted to an array-of-structures at the end of every step for rendering
+	glm::vec3 *cloth_pts_;
+
 	glm::vec3 *norms_;
 	glm::vec3 *tans_;
+	// false while the normals or the tangents lag behind the positions
+	mutable bool normals_current_;
+	mutable bool tangents_current_;
 	glm::vec2 *uvs_;
 	unsigned int *indices_;
-
-	// Rendering info- includes the mesh, indices, and textures
 	int num_tris_;
-	GLuint cloth_vao_;
-	GLuint mesh_buffer_;
-	GLuint index_buffer_;
-	GLuint diffuse_map_;
-	GLuint normal_map_;
-
-	glm::vec3* calcForces();
-	void calcVertexNormals();
-	void calcVertexTangents();
-	void loadTexture(std::string file_name, GLuint *texture);
-	void updateGPU();
-};
\ No newline at end of file
+
+	ForceMode force_mode_;
+	// Points per rope segment in the tiled passes, ropes up to this length are not split
+	int tile_size_;
+	SimdLevel simd_level_;
+	SpringRunKernel spring_kernel_;
+
+	std::unique_ptr<ThreadPool> pool_;
+	ClothWorkspace workspace_;
+	ClothStats stats_;
+
+	Integrator integrator_;
+	ImplicitSolver implicit_;
+	XpbdSolver xpbd_;
+	ProjectiveSolver projective_;
+	// false until the solver knows the current springs
+	bool implicit_ready_;
+	bool xpbd_ready_;
+	bool projective_ready_;
+	// Integrator::VelocityVerlet: the workspace forces belong to the current state
+	bool forces_current_;
+	int max_substeps_;
+	// most springs at any point and the shortest rest length, 0 until first needed
+	int max_point_springs_;
+	float min_rest_length_;
+	bool sleeping_;
+	SleepTracker sleep_;
+	unsigned long step_count_;
+	int num_change_blocks_;
+	int change_block_stride_;  // blocks per rope, 0 for meshes
+	int *block_start_;
+	unsigned long *block_change_step_;
+	bool *block_moved_;
+	glm::vec3 *block_lower_;
+	glm::vec3 *block_upper_;
+	SpringList grid_springs_;
+
+	virtual void calcForces(Vec3Lanes &forces);
+	virtual void calcExternalForces(Vec3Lanes &forces);
+	void calcForcesScatter(Vec3Lanes &forces);
+	void calcForcesGather(Vec3Lanes &forces);
+	void calcForcesTiled(Vec3Lanes &forces, const ForceParams &params);
+	void calcForcesAwake(Vec3Lanes &forces);
+	virtual void calcRopeForces(Vec3Lanes &forces, int j, bool reuse_prev, const ForceParams &params,
+		GatherScratch &scratch);
+	void stepFused(Vec3Lanes &forces, float h);
+	ForceParams forceParams() const;
+	GatherScratch gatherScratch(int thread);
+	void integrate(const Vec3Lanes &forces, float h);
+	void integratePoints(const Vec3Lanes &forces, int first, int last, float h);
+	void kickDrift(const Vec3Lanes *forces, float kick, float drift);
+	void storePositions();
+	void markAllChanged();
+	void setupChangeBlocks(int num_blocks, int stride);
+	void calcBlockBounds();
+	bool sleepActive() const;
+	template <typename Fn>
+	void forEachAwakeRun(const Fn &fn);
+	void stepImplicit(Vec3Lanes &forces, float h);
+	void stepXpbd(Vec3Lanes &forces, float h);
+	void stepProjective(Vec3Lanes &forces, float h);
+	virtual const SpringList& springList();
+	virtual void calcShading(bool tangents) const;
+	template <typename Vertex>
+	void writeFloatVertices(Vertex *vertices, int first, int last) const;
+	template <typename Vertex>
+	void writeCompactVertices(Vertex *vertices, int first, int last, const glm::vec3 &box_lower,
+		const glm::vec3 &box_extent) const;
+};
+#endif  // CLOTH_H
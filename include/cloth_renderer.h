@@ -0,0 +1,124 @@
+#ifndef CLOTH_RENDERER_H
+#define CLOTH_RENDERER_H
+
+#include <string>
+
+#include <glad/glad.h>
+
+#include "cloth.h"
+
+/**
+ * Layout of the vertices sent to the GPU.
+ * Float sends positions, normals and tangents as RenderVertex floats (36 bytes per point) and the
+ * UVs as floats, for shaders with vec3 vertex, normal and tangent inputs.
+ * Compact sends CompactVertex (16 bytes per point) and the UVs as 16 bit unsigned normalized
+ * values, or as halfs when they leave [0, 1]. The shader gets the quantized position as a vec4
+ * vertex input and the octahedral normal and tangent as vec2 inputs, and the quantization box as
+ * the position_lower and position_extent uniforms, see data/oren_nayar_compact_vert.glsl.
+ * Positions sends only the positions (12 bytes per point) to a GL_RGB32F buffer texture, the
+ * positions sampler of the shader. There is no per vertex position, normal or tangent input, the
+ * vertex shader fetches its point and the grid neighbors by gl_VertexID, with the grid size in the
+ * num_ropes and points_per_rope uniforms, and computes the normal and the tangent itself, see
+ * data/oren_nayar_positions_vert.glsl. The cloth computes no shading attributes at all. Needs a
+ * grid cloth and GL_ARB_texture_buffer_object_rgb32, see ClothRenderer::SupportsFormat().
+ */
+enum class VertexFormat {
+	Float,
+	Compact,
+	Positions
+};
+
+/**
+ * OpenGL renderer for a Cloth. The renderer only reads the cloth's state, so the
+ * simulation itself can run without an OpenGL context.
+ * The vertices are split into a static stream with the texture coordinates, uploaded once with
+ * the indices, and a dynamic stream of interleaved RenderVertex positions, normals and tangents.
+ * With GL_ARB_buffer_storage the dynamic stream is a persistently mapped ring of kRingSegments
+ * copies of the vertices, every Update() writes the next copy directly while the GPU may still
+ * draw the older ones, a fence per copy keeps the CPU from overwriting a copy in use. Without the
+ * extension the changed vertices are uploaded with glBufferSubData.
+ * initGL() only sends the attributes the linked shader reads: without an active tangent input
+ * the tangents are neither computed nor uploaded (RenderVertexNoTangent or CompactVertexNoTangent),
+ * without an active tex_coord input there are no UVs in the static stream.
+ */
+class ClothRenderer {
+public:
+	static const int kRingSegments = 3;
+	// Texture unit of the positions buffer texture, after the diffuse and normal maps
+	static const int kPositionTextureUnit = 2;
+
+	explicit ClothRenderer(const Cloth &cloth);
+
+	~ClothRenderer();
+
+	ClothRenderer(const ClothRenderer&) = delete;
+	ClothRenderer& operator=(const ClothRenderer&) = delete;
+
+	// Whether initGL() may use a persistently mapped ring when the driver supports one, true by
+	// default
+	void SetPersistentMapping(bool enabled) { persistent_mapping_ = enabled; }
+	bool UsesPersistentMapping() const { return ring_ != nullptr; }
+	// The vertex layout, set before initGL(), VertexFormat::Float by default
+	void SetVertexFormat(VertexFormat format) { format_ = format; }
+	// Whether format can draw cloth with the current context
+	static bool SupportsFormat(VertexFormat format, const Cloth &cloth);
+	VertexFormat GetVertexFormat() const { return format_; }
+	// Whether the shader passed to initGL() reads the tangents and the texture coordinates
+	bool UsesTangents() const { return tan_attrib_ >= 0; }
+	bool UsesTexCoords() const { return uv_attrib_ >= 0; }
+
+	void initGL(GLuint shader);
+
+	void Update();
+
+	void Draw();
+
+	/** Bytes written for the GPU by the last Update(), to measure the per frame bus traffic. */
+	size_t LastUploadBytes() const { return last_upload_bytes_; }
+
+private:
+	const Cloth &cloth_;
+
+	// Rendering info- includes the mesh, indices, and textures
+	GLuint cloth_vao_;
+	GLuint static_buffer_;
+	GLuint dynamic_buffer_;
+	GLuint index_buffer_;
+	GLuint diffuse_map_;
+	GLuint normal_map_;
+	GLuint position_texture_;
+
+	VertexFormat format_;
+	size_t vertex_size_;
+	GLint pos_attrib_;
+	GLint norm_attrib_;
+	GLint tan_attrib_;
+	GLint uv_attrib_;
+	GLint box_lower_uniform_;
+	GLint box_extent_uniform_;
+
+	// the dynamic stream holds num_segments_ copies of the vertices, segment_size_ bytes apart,
+	// the one drawn is segment_, segment_step_ is the cloth step whose state each copy holds
+	bool persistent_mapping_;
+	int num_segments_;
+	size_t segment_size_;
+	int segment_;
+	unsigned long segment_step_[kRingSegments];
+	GLsync fences_[kRingSegments];
+	// the quantization box of every copy in the compact format, once box_fitted_
+	bool box_fitted_[kRingSegments];
+	glm::vec3 box_lower_[kRingSegments];
+	glm::vec3 box_extent_[kRingSegments];
+	size_t last_upload_bytes_;
+	// the mapped ring, or null when the vertices are interleaved in staging_ and then uploaded
+	char *ring_;
+	char *staging_;
+
+	void initStaticStream();
+	bool fitQuantizationBox(int segment);
+	void bindDynamicStream(int segment);
+	void waitForSegment(int segment);
+	void writeBlocks(int segment, int first_block, int last_block);
+	void loadTexture(std::string file_name, GLuint *texture);
+};
+#endif  // CLOTH_RENDERER_H
@@ -0,0 +1,59 @@
+#ifndef CLOTH_WORKSPACE_H
+#define CLOTH_WORKSPACE_H
+
+#include "particle_store.h"
+
+// Per-thread scratch lanes, each one holds the results of a run of springs or a strip of
+// drag quads before they are added to the cloth points
+enum RunScratchSlot {
+	kVerticalSprings,
+	kPrevSprings,
+	kNextSprings,
+	kPrevDragFirst,
+	kPrevDragSecond,
+	kNextDragFirst,
+	kNextDragSecond,
+	kNumRunScratch
+};
+
+// Per-thread partial results of reductions over the cloth
+enum ThreadScalarSlot {
+	kMaxSpeedSquared,
+	kMaxStretch,
+	kNumThreadScalars
+};
+
+/**
+ * Per-cloth scratch memory used while stepping the simulation. The buffers are allocated
+ * once for a given number of cloth points and reused by every Update(), so a steady-state
+ * step never touches the heap. Resize() only reallocates when the point count changes.
+ * Scratch buffers used inside parallel loops exist once per thread.
+ */
+class ClothWorkspace {
+public:
+	ClothWorkspace();
+
+	~ClothWorkspace();
+
+	ClothWorkspace(const ClothWorkspace&) = delete;
+	ClothWorkspace& operator=(const ClothWorkspace&) = delete;
+
+	void Resize(int num_pts, int max_run, int num_threads);
+
+	int Size() const { return num_pts_; }
+
+	// Net force acting on each cloth point
+	Vec3Lanes& Forces() { return forces_.Lanes(); }
+	Vec3Lanes& RunScratch(int thread, RunScratchSlot slot) { return run_scratch_[thread * kNumRunScratch + slot].Lanes(); }
+	float& ThreadScalar(int thread, ThreadScalarSlot slot) { return thread_scalars_[thread * kNumThreadScalars + slot]; }
+
+private:
+	int num_pts_;
+	int num_threads_;
+
+	Vec3LaneBuffer forces_;
+	Vec3LaneBuffer *run_scratch_;
+	float *thread_scalars_;
+};
+
+#endif  // CLOTH_WORKSPACE_H
@@ -0,0 +1,544 @@
+#ifndef FORCE_KERNELS_H
+#define FORCE_KERNELS_H
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+#include "particle_store.h"
+#include "spring_kernels.h"
+
+// Building blocks of the force passes. The run lengths are template parameters so the same
+// code serves the runtime sized Cloth (Count = int) and the fixed size GridCloth
+// (Count = std::integral_constant<int, N>), where every loop bound is a compile-time constant.
+
+template <int N>
+using FixedCount = std::integral_constant<int, N>;
+
+// Downward gravity force on every cloth point, the same whatever its mass
+const float kGravityForce = .1f;
+
+/**
+ * Constants shared by every spring and drag kernel of a cloth.
+ */
+struct ForceParams {
+	float k;
+	float kv;
+	float rest_length;
+	float drag_coef;
+	glm::vec3 air_res;
+};
+
+/**
+ * Describe the run of n springs whose end points are stored contiguously starting at points a
+ * and b, the spring kernel writes the force acting on each a end into out.
+ */
+inline SpringRun makeSpringRun(const Vec3Lanes &pos, const Vec3Lanes &vel, int a, int b, int n,
+	const ForceParams &params, Vec3Lanes &out) {
+	SpringRun run;
+	run.ax = pos.x + a;
+	run.ay = pos.y + a;
+	run.az = pos.z + a;
+	run.bx = pos.x + b;
+	run.by = pos.y + b;
+	run.bz = pos.z + b;
+	run.vax = vel.x + a;
+	run.vay = vel.y + a;
+	run.vaz = vel.z + a;
+	run.vbx = vel.x + b;
+	run.vby = vel.y + b;
+	run.vbz = vel.z + b;
+	run.fx = out.x;
+	run.fy = out.y;
+	run.fz = out.z;
+	run.n = n;
+	run.k = params.k;
+	run.kv = params.kv;
+	run.rest_length = params.rest_length;
+	return run;
+}
+
+/**
+ * Portable spring kernel with a compile-time run length, left to the compiler to vectorize.
+ */
+template <typename Count>
+inline void evalSpringRun(const SpringRun &run, Count n) {
+	const float * __restrict ax = run.ax;
+	const float * __restrict ay = run.ay;
+	const float * __restrict az = run.az;
+	const float * __restrict bx = run.bx;
+	const float * __restrict by = run.by;
+	const float * __restrict bz = run.bz;
+	const float * __restrict vax = run.vax;
+	const float * __restrict vay = run.vay;
+	const float * __restrict vaz = run.vaz;
+	const float * __restrict vbx = run.vbx;
+	const float * __restrict vby = run.vby;
+	const float * __restrict vbz = run.vbz;
+	float * __restrict fx = run.fx;
+	float * __restrict fy = run.fy;
+	float * __restrict fz = run.fz;
+	for (int i = 0; i < n; ++i) {
+		float dx = ax[i] - bx[i];
+		float dy = ay[i] - by[i];
+		float dz = az[i] - bz[i];
+		float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+		float string_force = -run.k * (length - run.rest_length);
+
+		float inv_length = 1.0f / length;
+		dx *= inv_length;
+		dy *= inv_length;
+		dz *= inv_length;
+		float rel_vel = (vax[i] - vbx[i]) * dx + (vay[i] - vby[i]) * dy + (vaz[i] - vbz[i]) * dz;
+		float force = string_force - run.kv * rel_vel;
+		fx[i] = dx * force;
+		fy[i] = dy * force;
+		fz[i] = dz * force;
+	}
+}
+
+/**
+ * Add sign times the spring forces of a run to the n points starting at start. The a ends of
+ * a run receive the forces with a sign of 1 and the b ends with a sign of -1.
+ */
+template <typename Count>
+inline void addSpringEnds(Vec3Lanes &forces, const Vec3Lanes &spring, int start, Count n, float sign) {
+	const float * __restrict sx = spring.x;
+	const float * __restrict sy = spring.y;
+	const float * __restrict sz = spring.z;
+	float * __restrict fx = forces.x + start;
+	float * __restrict fy = forces.y + start;
+	float * __restrict fz = forces.z + start;
+	for (int i = 0; i < n; ++i) {
+		fx[i] += sign * sx[i];
+		fy[i] += sign * sy[i];
+		fz[i] += sign * sz[i];
+	}
+}
+
+/**
+ * Add the spring forces produced by a spring kernel to both ends of each spring.
+ */
+template <typename Count>
+inline void accumulateSpringRun(Vec3Lanes &forces, const Vec3Lanes &spring, int a, int b, Count n) {
+	addSpringEnds(forces, spring, a, n, 1.0f);
+	addSpringEnds(forces, spring, b, n, -1.0f);
+}
+
+/**
+ * Evaluate the air drag on a strip of n quads between the ropes starting at points a and b.
+ * Quad i is split into the triangles (a + i, a + i + 1, b + i) and (a + i + 1, b + i + 1, b + i),
+ * the drag each triangle applies to each of its corners is written to first and second.
+ */
+template <typename Count>
+inline void calcDragRun(const Vec3Lanes &pos, const Vec3Lanes &vel, int a, int b, Count n,
+	const ForceParams &params, Vec3Lanes &first, Vec3Lanes &second) {
+	const float * __restrict p1x = pos.x + a;
+	const float * __restrict p1y = pos.y + a;
+	const float * __restrict p1z = pos.z + a;
+	const float * __restrict p3x = pos.x + b;
+	const float * __restrict p3y = pos.y + b;
+	const float * __restrict p3z = pos.z + b;
+	const float * __restrict v1x = vel.x + a;
+	const float * __restrict v1y = vel.y + a;
+	const float * __restrict v1z = vel.z + a;
+	const float * __restrict v3x = vel.x + b;
+	const float * __restrict v3y = vel.y + b;
+	const float * __restrict v3z = vel.z + b;
+	float * __restrict r1x = first.x;
+	float * __restrict r1y = first.y;
+	float * __restrict r1z = first.z;
+	float * __restrict r2x = second.x;
+	float * __restrict r2y = second.y;
+	float * __restrict r2z = second.z;
+	const glm::vec3 air_res = params.air_res;
+	// -0.5 * drag_coef, then divided by 3 to spread it over the triangle's corners
+	float scale = -0.5f * params.drag_coef / 3.0f;
+	for (int i = 0; i < n; ++i) {
+		// start with one triangle
+		float avg_x = (v1x[i] + v1x[i + 1] + v3x[i]) / 3.0f - air_res.x;
+		float avg_y = (v1y[i] + v1y[i + 1] + v3y[i]) / 3.0f - air_res.y;
+		float avg_z = (v1z[i] + v1z[i + 1] + v3z[i]) / 3.0f - air_res.z;
+		float e1x = p1x[i] - p1x[i + 1];
+		float e1y = p1y[i] - p1y[i + 1];
+		float e1z = p1z[i] - p1z[i + 1];
+		float e2x = p3x[i] - p1x[i + 1];
+		float e2y = p3y[i] - p1y[i + 1];
+		float e2z = p3z[i] - p1z[i + 1];
+		float nx = e1y * e2z - e1z * e2y;
+		float ny = e1z * e2x - e1x * e2z;
+		float nz = e1x * e2y - e1y * e2x;
+		float avg_len = std::sqrt(avg_x * avg_x + avg_y * avg_y + avg_z * avg_z);
+		float v_a_n = avg_len * (avg_x * nx + avg_y * ny + avg_z * nz) * 0.5f;
+		float res = scale * v_a_n / std::sqrt(nx * nx + ny * ny + nz * nz);
+		r1x[i] = res * nx;
+		r1y[i] = res * ny;
+		r1z[i] = res * nz;
+
+		// now do the other triangle
+		avg_x = (v1x[i + 1] + v3x[i + 1] + v3x[i + 1]) / 3.0f;
+		avg_y = (v1y[i + 1] + v3y[i + 1] + v3y[i + 1]) / 3.0f;
+		avg_z = (v1z[i + 1] + v3z[i + 1] + v3z[i + 1]) / 3.0f;
+		e1x = p1x[i + 1] - p3x[i + 1];
+		e1y = p1y[i + 1] - p3y[i + 1];
+		e1z = p1z[i + 1] - p3z[i + 1];
+		e2x = p3x[i] - p3x[i + 1];
+		e2y = p3y[i] - p3y[i + 1];
+		e2z = p3z[i] - p3z[i + 1];
+		nx = e1y * e2z - e1z * e2y;
+		ny = e1z * e2x - e1x * e2z;
+		nz = e1x * e2y - e1y * e2x;
+		avg_len = std::sqrt(avg_x * avg_x + avg_y * avg_y + avg_z * avg_z);
+		v_a_n = avg_len * (avg_x * nx + avg_y * ny + avg_z * nz) * 0.75f;
+		res = scale * v_a_n / std::sqrt(nx * nx + ny * ny + nz * nz);
+		r2x[i] = res * nx;
+		r2y[i] = res * ny;
+		r2z[i] = res * nz;
+	}
+}
+
+/**
+ * Add the drag produced by calcDragRun() to the corners of each triangle that lie on the
+ * rope starting at point a.
+ */
+template <typename Count>
+inline void addDragToA(Vec3Lanes &forces, const Vec3Lanes &first, const Vec3Lanes &second, int a, Count n) {
+	float *lanes[3] = { forces.x, forces.y, forces.z };
+	const float *firsts[3] = { first.x, first.y, first.z };
+	const float *seconds[3] = { second.x, second.y, second.z };
+	for (int c = 0; c < 3; ++c) {
+		const float * __restrict r1 = firsts[c];
+		const float * __restrict r2 = seconds[c];
+		float * __restrict fa = lanes[c] + a;
+		for (int i = 0; i < n; ++i) {
+			fa[i] += r1[i];
+		}
+		for (int i = 0; i < n; ++i) {
+			fa[i + 1] += r1[i] + r2[i];
+		}
+	}
+}
+
+/**
+ * Add the drag produced by calcDragRun() to the corners of each triangle that lie on the
+ * rope starting at point b.
+ */
+template <typename Count>
+inline void addDragToB(Vec3Lanes &forces, const Vec3Lanes &first, const Vec3Lanes &second, int b, Count n) {
+	float *lanes[3] = { forces.x, forces.y, forces.z };
+	const float *firsts[3] = { first.x, first.y, first.z };
+	const float *seconds[3] = { second.x, second.y, second.z };
+	for (int c = 0; c < 3; ++c) {
+		const float * __restrict r1 = firsts[c];
+		const float * __restrict r2 = seconds[c];
+		float * __restrict fb = lanes[c] + b;
+		for (int i = 0; i < n; ++i) {
+			fb[i] += r1[i] + r2[i];
+		}
+		for (int i = 0; i < n; ++i) {
+			fb[i + 1] += r2[i];
+		}
+	}
+}
+
+/**
+ * Add the drag produced by calcDragRun() to all three corners of each triangle.
+ */
+template <typename Count>
+inline void accumulateDragRun(Vec3Lanes &forces, const Vec3Lanes &first, const Vec3Lanes &second,
+	int a, int b, Count n) {
+	addDragToA(forces, first, second, a, n);
+	addDragToB(forces, first, second, b, n);
+}
+
+/**
+ * The lanes starting offset entries into lanes.
+ */
+inline Vec3Lanes offsetLanes(const Vec3Lanes &lanes, int offset) {
+	Vec3Lanes result;
+	result.x = lanes.x + offset;
+	result.y = lanes.y + offset;
+	result.z = lanes.z + offset;
+	return result;
+}
+
+/**
+ * Face normals and tangent edges of quad i between the ropes starting at a and b, split into
+ * the triangles (a + i, a + i + 1, b + i) and (a + i + 1, b + i + 1, b + i) like the index buffer.
+ * The normals are not normalized, so they are weighted by the triangle area. With the UVs of a
+ * grid cloth, u across the ropes and v along them with the same spacing, the tangent of both
+ * triangles is their edge across the ropes times the same constant, so the edge stands in for it.
+ */
+struct QuadShading {
+	glm::vec3 first_normal;
+	glm::vec3 second_normal;
+	glm::vec3 first_tangent;
+	glm::vec3 second_tangent;
+};
+
+inline QuadShading quadShading(const glm::vec3 *a, const glm::vec3 *b, int i) {
+	QuadShading quad;
+	quad.first_normal = glm::cross(a[i + 1] - a[i], b[i] - a[i]);
+	quad.second_normal = glm::cross(b[i + 1] - a[i + 1], b[i] - a[i + 1]);
+	quad.first_tangent = b[i] - a[i];
+	quad.second_tangent = b[i + 1] - a[i + 1];
+	return quad;
+}
+
+/**
+ * Normals and tangents of the points [first, last) of rope j, gathered from the up to six
+ * triangles around each point straight from the grid neighbors, without the index buffer. A
+ * point is corner a + i of quad i and a + i + 1 of quad i - 1 of the strip to the next rope, and
+ * b + i, b + i + 1 of the same quads of the strip to the previous rope. The quads before the
+ * point are carried along the rope, so every quad is evaluated once per rope it touches and
+ * ropes can be split among threads without any two writing the same point. Without kTangents
+ * only the normals are computed and tans is not touched.
+ */
+template <bool kTangents, typename RopeLen>
+inline void gridShadingRun(const glm::vec3 *pts, glm::vec3 *norms, glm::vec3 *tans, int j, int num_ropes,
+	RopeLen pts_per_rope, int first, int last) {
+	const glm::vec3 *rope = pts + j * pts_per_rope;
+	const glm::vec3 *prev = rope - pts_per_rope;
+	const glm::vec3 *next = rope + pts_per_rope;
+	bool has_prev = j > 0;
+	bool has_next = j < num_ropes - 1;
+	QuadShading prev_quad;
+	QuadShading next_quad;
+	if (first > 0) {
+		if (has_prev) {
+			prev_quad = quadShading(prev, rope, first - 1);
+		}
+		if (has_next) {
+			next_quad = quadShading(rope, next, first - 1);
+		}
+	}
+	for (int i = first; i < last; ++i) {
+		glm::vec3 normal(0, 0, 0);
+		glm::vec3 tangent(0, 0, 0);
+		if (has_prev && i > 0) {
+			normal += prev_quad.second_normal;
+			tangent += prev_quad.second_tangent;
+		}
+		if (has_next && i > 0) {
+			normal += next_quad.first_normal + next_quad.second_normal;
+			tangent += next_quad.first_tangent + next_quad.second_tangent;
+		}
+		if (i < pts_per_rope - 1) {
+			if (has_prev) {
+				prev_quad = quadShading(prev, rope, i);
+				normal += prev_quad.first_normal + prev_quad.second_normal;
+				tangent += prev_quad.first_tangent + prev_quad.second_tangent;
+			}
+			if (has_next) {
+				next_quad = quadShading(rope, next, i);
+				normal += next_quad.first_normal;
+				tangent += next_quad.first_tangent;
+			}
+		}
+		norms[j * pts_per_rope + i] = glm::normalize(normal);
+		if (kTangents) {
+			tans[j * pts_per_rope + i] = glm::normalize(tangent);
+		}
+	}
+}
+
+// A segment is the range [seg_first, seg_end) of the points of a rope. The springs along the
+// rope and the quads of a strip both form runs where run q ties point q to point q + 1, a
+// segment is touched by the runs [segmentRunsFirst(), segmentRunsEnd()).
+
+inline int segmentRunsFirst(int seg_first) {
+	return seg_first > 0 ? seg_first - 1 : 0;
+}
+
+inline int segmentRunsEnd(int seg_end, int pts_per_rope) {
+	return seg_end < pts_per_rope ? seg_end : pts_per_rope - 1;
+}
+
+/**
+ * Add sign times the values of runs [q0, q1) to their first point q, for the points inside the
+ * segment only. values holds run q0 at index 0, dst holds point seg_first at index dst_first.
+ */
+inline void addToFirstPoints(Vec3Lanes &dst, int dst_first, const Vec3Lanes &values, int q0, int q1,
+	int seg_first, int seg_end, float sign) {
+	int p0 = std::max(q0, seg_first);
+	int p1 = std::min(q1, seg_end);
+	if (p1 > p0) {
+		addSpringEnds(dst, offsetLanes(values, p0 - q0), dst_first + p0 - seg_first, p1 - p0, sign);
+	}
+}
+
+/**
+ * Like addToFirstPoints(), for the second point q + 1 of each run.
+ */
+inline void addToSecondPoints(Vec3Lanes &dst, int dst_first, const Vec3Lanes &values, int q0, int q1,
+	int seg_first, int seg_end, float sign) {
+	int p0 = std::max(q0 + 1, seg_first);
+	int p1 = std::min(q1 + 1, seg_end);
+	if (p1 > p0) {
+		addSpringEnds(dst, offsetLanes(values, p0 - 1 - q0), dst_first + p0 - seg_first, p1 - p0, sign);
+	}
+}
+
+/**
+ * Add the per-triangle values of a strip of quads [q0, q1) to the corners that lie in the
+ * segment, on the rope that is the a side of the strip.
+ */
+inline void addStripToA(Vec3Lanes &dst, int dst_first, const Vec3Lanes &first, const Vec3Lanes &second,
+	int q0, int q1, int seg_first, int seg_end) {
+	addToFirstPoints(dst, dst_first, first, q0, q1, seg_first, seg_end, 1.0f);
+	addToSecondPoints(dst, dst_first, first, q0, q1, seg_first, seg_end, 1.0f);
+	addToSecondPoints(dst, dst_first, second, q0, q1, seg_first, seg_end, 1.0f);
+}
+
+/**
+ * Like addStripToA(), on the rope that is the b side of the strip.
+ */
+inline void addStripToB(Vec3Lanes &dst, int dst_first, const Vec3Lanes &first, const Vec3Lanes &second,
+	int q0, int q1, int seg_first, int seg_end) {
+	addToFirstPoints(dst, dst_first, first, q0, q1, seg_first, seg_end, 1.0f);
+	addToFirstPoints(dst, dst_first, second, q0, q1, seg_first, seg_end, 1.0f);
+	addToSecondPoints(dst, dst_first, second, q0, q1, seg_first, seg_end, 1.0f);
+}
+
+/**
+ * Set the n points starting at start to the gravity force.
+ */
+template <typename Count>
+inline void initForces(Vec3Lanes &forces, int start, Count n) {
+	float * __restrict fx = forces.x + start;
+	float * __restrict fy = forces.y + start;
+	float * __restrict fz = forces.z + start;
+	for (int i = 0; i < n; ++i) {
+		fx[i] = 0.0f;
+		fy[i] = -kGravityForce;
+		fz[i] = 0.0f;
+	}
+}
+
+/**
+ * Scratch lanes used by gatherRopeForces(). The strip shared with the next rope becomes the
+ * strip shared with the previous rope once the loop advances, Advance() swaps them.
+ */
+struct GatherScratch {
+	Vec3Lanes vertical;
+	Vec3Lanes prev_springs;
+	Vec3Lanes next_springs;
+	Vec3Lanes prev_drag_first;
+	Vec3Lanes prev_drag_second;
+	Vec3Lanes next_drag_first;
+	Vec3Lanes next_drag_second;
+
+	void Advance() {
+		std::swap(prev_springs, next_springs);
+		std::swap(prev_drag_first, next_drag_first);
+		std::swap(prev_drag_second, next_drag_second);
+	}
+};
+
+/**
+ * Overwrite the forces of rope j with the sum of gravity, its own springs and drag triangles.
+ * Only points of rope j are written. When reuse_prev is set, the strip shared with rope j - 1
+ * is taken from the scratch instead of being evaluated again. eval_springs(run) must fill in
+ * run.f* for run.n springs.
+ */
+template <typename RopeLen, typename SpringLen, typename SpringEval>
+inline void gatherRopeForces(const Vec3Lanes &pos, const Vec3Lanes &vel, Vec3Lanes &forces, int j, int num_ropes,
+	RopeLen pts_per_rope, SpringLen springs_per_rope, bool reuse_prev, const ForceParams &params,
+	GatherScratch &scratch, const SpringEval &eval_springs) {
+	int rope_start = j * pts_per_rope;
+	initForces(forces, rope_start, pts_per_rope);
+
+	// springs along the rope
+	eval_springs(makeSpringRun(pos, vel, rope_start, rope_start + 1, springs_per_rope, params, scratch.vertical));
+	accumulateSpringRun(forces, scratch.vertical, rope_start, rope_start + 1, springs_per_rope);
+
+	// springs and triangles shared with the previous rope, this rope is their b end
+	if (j > 0) {
+		int prev_start = rope_start - pts_per_rope;
+		if (!reuse_prev) {
+			eval_springs(makeSpringRun(pos, vel, prev_start, rope_start, pts_per_rope, params, scratch.prev_springs));
+			calcDragRun(pos, vel, prev_start, rope_start, springs_per_rope, params, scratch.prev_drag_first, scratch.prev_drag_second);
+		}
+		addSpringEnds(forces, scratch.prev_springs, rope_start, pts_per_rope, -1.0f);
+		addDragToB(forces, scratch.prev_drag_first, scratch.prev_drag_second, rope_start, springs_per_rope);
+	}
+
+	// springs and triangles shared with the next rope, this rope is their a end
+	if (j < num_ropes - 1) {
+		int next_start = rope_start + pts_per_rope;
+		eval_springs(makeSpringRun(pos, vel, rope_start, next_start, pts_per_rope, params, scratch.next_springs));
+		calcDragRun(pos, vel, rope_start, next_start, springs_per_rope, params, scratch.next_drag_first, scratch.next_drag_second);
+		addSpringEnds(forces, scratch.next_springs, rope_start, pts_per_rope, 1.0f);
+		addDragToA(forces, scratch.next_drag_first, scratch.next_drag_second, rope_start, springs_per_rope);
+	}
+}
+
+/**
+ * Overwrite the forces of rope j with gravity and the drag of its triangles, gatherRopeForces()
+ * without the springs.
+ */
+template <typename RopeLen, typename SpringLen>
+inline void gatherRopeDrag(const Vec3Lanes &pos, const Vec3Lanes &vel, Vec3Lanes &forces, int j, int num_ropes,
+	RopeLen pts_per_rope, SpringLen springs_per_rope, bool reuse_prev, const ForceParams &params,
+	GatherScratch &scratch) {
+	int rope_start = j * pts_per_rope;
+	initForces(forces, rope_start, pts_per_rope);
+	if (j > 0) {
+		if (!reuse_prev) {
+			calcDragRun(pos, vel, rope_start - pts_per_rope, rope_start, springs_per_rope, params,
+				scratch.prev_drag_first, scratch.prev_drag_second);
+		}
+		addDragToB(forces, scratch.prev_drag_first, scratch.prev_drag_second, rope_start, springs_per_rope);
+	}
+	if (j < num_ropes - 1) {
+		calcDragRun(pos, vel, rope_start, rope_start + pts_per_rope, springs_per_rope, params,
+			scratch.next_drag_first, scratch.next_drag_second);
+		addDragToA(forces, scratch.next_drag_first, scratch.next_drag_second, rope_start, springs_per_rope);
+	}
+}
+
+/**
+ * gatherRopeForces() for the points [seg_first, seg_end) of rope j only. The springs and quads
+ * that tie the segment to the neighboring segments are evaluated by both of them.
+ */
+template <typename SpringEval>
+inline void gatherSegmentForces(const Vec3Lanes &pos, const Vec3Lanes &vel, Vec3Lanes &forces, int j, int num_ropes,
+	int pts_per_rope, int seg_first, int seg_end, bool reuse_prev, const ForceParams &params,
+	GatherScratch &scratch, const SpringEval &eval_springs) {
+	int rope_start = j * pts_per_rope;
+	int seg_start = rope_start + seg_first;
+	int seg_len = seg_end - seg_first;
+	int q0 = segmentRunsFirst(seg_first);
+	int q1 = segmentRunsEnd(seg_end, pts_per_rope);
+	initForces(forces, seg_start, seg_len);
+
+	// springs along the rope
+	eval_springs(makeSpringRun(pos, vel, rope_start + q0, rope_start + q0 + 1, q1 - q0, params, scratch.vertical));
+	addToFirstPoints(forces, seg_start, scratch.vertical, q0, q1, seg_first, seg_end, 1.0f);
+	addToSecondPoints(forces, seg_start, scratch.vertical, q0, q1, seg_first, seg_end, -1.0f);
+
+	// springs and triangles shared with the previous rope, this rope is their b end
+	if (j > 0) {
+		int prev_start = rope_start - pts_per_rope;
+		if (!reuse_prev) {
+			eval_springs(makeSpringRun(pos, vel, prev_start + seg_first, seg_start, seg_len, params, scratch.prev_springs));
+			calcDragRun(pos, vel, prev_start + q0, rope_start + q0, q1 - q0, params, scratch.prev_drag_first, scratch.prev_drag_second);
+		}
+		addSpringEnds(forces, scratch.prev_springs, seg_start, seg_len, -1.0f);
+		addStripToB(forces, seg_start, scratch.prev_drag_first, scratch.prev_drag_second, q0, q1, seg_first, seg_end);
+	}
+
+	// springs and triangles shared with the next rope, this rope is their a end
+	if (j < num_ropes - 1) {
+		int next_start = rope_start + pts_per_rope;
+		eval_springs(makeSpringRun(pos, vel, seg_start, next_start + seg_first, seg_len, params, scratch.next_springs));
+		calcDragRun(pos, vel, rope_start + q0, next_start + q0, q1 - q0, params, scratch.next_drag_first, scratch.next_drag_second);
+		addSpringEnds(forces, scratch.next_springs, seg_start, seg_len, 1.0f);
+		addStripToA(forces, seg_start, scratch.next_drag_first, scratch.next_drag_second, q0, q1, seg_first, seg_end);
+	}
+}
+
+#endif  // FORCE_KERNELS_H
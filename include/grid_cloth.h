@@ -0,0 +1,66 @@
+#ifndef GRID_CLOTH_H
+#define GRID_CLOTH_H
+
+#include "cloth.h"
+#include "force_kernels.h"
+
+/**
+ * A Cloth whose size is fixed at compile time, W ropes of H points each. The force and normal
+ * passes are instantiated for these dimensions, so every loop bound and rope offset is a
+ * constant. The spring runs still go to the hand written SIMD kernel when the CPU has one, see
+ * evalGridSprings(). The fixed size spring kernel, which the compiler can fully unroll and
+ * vectorize without remainder handling, only runs at SimdLevel::Scalar. Use the runtime sized
+ * Cloth for any other resolution.
+ *
+ * The fixed size kernels gather the forces per rope, so they serve ForceMode::Gather and
+ * ForceMode::Fused, ForceMode::Scatter keeps the runtime sized kernels. The normals and tangents
+ * are gathered per rope too, from the triangles of the two strips around it, so no two threads
+ * ever write the same point and the pass runs on the thread pool.
+ */
+template <int W, int H>
+class GridCloth : public Cloth {
+	static_assert(W >= 2 && H >= 2, "a grid cloth needs at least 2 ropes of 2 points");
+public:
+	GridCloth(float k, float kv, float mass, float rest_length, float drag_coef,
+		float start_x, float start_y, float z_val, ForceMode force_mode = ForceMode::Gather)
+		: Cloth(W, H, k, kv, mass, rest_length, drag_coef, start_x, start_y, z_val, force_mode) {
+	}
+
+protected:
+	void calcRopeForces(Vec3Lanes &forces, int j, bool reuse_prev, const ForceParams &params,
+		GatherScratch &scratch) override {
+		gatherRopeForces(pos_.Lanes(), vel_.Lanes(), forces, j, W, FixedCount<H>(), FixedCount<H - 1>(), reuse_prev,
+			params, scratch, [this](const SpringRun &run) { evalGridSprings(run); });
+	}
+
+	void calcShading(bool tangents) const override {
+		pool_->ParallelFor(0, W, [&](int first, int last, int) {
+			for (int j = first; j < last; j++) {
+				if (tangents) {
+					gridShadingRun<true>(cloth_pts_, norms_, tans_, j, W, FixedCount<H>(), 0, H);
+				} else {
+					gridShadingRun<false>(cloth_pts_, norms_, tans_, j, W, FixedCount<H>(), 0, H);
+				}
+			}
+		});
+	}
+
+private:
+	/**
+	 * Springs along a rope come in runs of H - 1, springs between two ropes in runs of H. The
+	 * hand written SIMD kernels beat what the compiler makes of the fixed size one unless the
+	 * whole build targets the same instruction set, so they take over whenever the CPU has one,
+	 * SSE4.2 or better on x86.
+	 */
+	void evalGridSprings(const SpringRun &run) const {
+		if (simd_level_ != SimdLevel::Scalar) {
+			spring_kernel_(run);
+		} else if (run.n == H) {
+			evalSpringRun(run, FixedCount<H>());
+		} else {
+			evalSpringRun(run, FixedCount<H - 1>());
+		}
+	}
+};
+
+#endif  // GRID_CLOTH_H
@@ -0,0 +1,86 @@
+#ifndef IMPLICIT_SOLVER_H
+#define IMPLICIT_SOLVER_H
+
+#include "particle_store.h"
+#include "spring_list.h"
+#include "thread_pool.h"
+
+/**
+ * Linearized backward Euler step for a mass-spring system (Baraff and Witkin, "Large Steps in
+ * Cloth Simulation", 1998). Solve() finds the velocity change dv of one step of length h from
+ *
+ *     (M - h df/dv - h^2 df/dx) dv = h (f + h df/dx v)
+ *
+ * where the 3x3 blocks of the Jacobians come from the springs, all other forces (gravity, air
+ * drag) are only taken into account explicitly through f. The system is symmetric positive
+ * definite and is solved with conjugate gradients, preconditioned by the inverse diagonal
+ * blocks. Points with an inverse mass of 0 are filtered out of the solve, their dv stays 0.
+ *
+ * All buffers are allocated by Setup(), a solve does not touch the heap.
+ */
+class ImplicitSolver {
+public:
+	ImplicitSolver();
+
+	~ImplicitSolver();
+
+	ImplicitSolver(const ImplicitSolver&) = delete;
+	ImplicitSolver& operator=(const ImplicitSolver&) = delete;
+
+	// Prepare for num_pts points tied by springs, call again whenever the springs change
+	void Setup(int num_pts, const SpringList &springs);
+
+	// Stop once the residual drops below tolerance times the right hand side, or after
+	// max_iterations
+	void SetTolerance(float tolerance, int max_iterations);
+
+	/**
+	 * Solve for the velocity change of one step, forces holds f at the current state. The
+	 * previous result is the initial guess. Returns the number of iterations used.
+	 */
+	int Solve(const Vec3Lanes &pos, const Vec3Lanes &vel, const Vec3Lanes &forces, const float *inv_mass,
+		float mass, float k, float kv, float h, ThreadPool &pool);
+
+	const Vec3Lanes& DeltaV() const { return dv_.Lanes(); }
+
+	// Residual norm relative to the right hand side after the last solve
+	float Residual() const { return residual_; }
+
+private:
+	int num_pts_;
+	const SpringList *springs_;
+	float tolerance_;
+	int max_iterations_;
+	float residual_;
+
+	// springs around each point in compressed rows, s when the point is the a end, ~s otherwise
+	int *point_springs_start_;
+	int *point_springs_;
+
+	// symmetric 3x3 blocks stored as xx, xy, xz, yy, yz, zz: the off-diagonal block of each
+	// spring, the diagonal block of each point and its inverse
+	float *off_diag_;
+	float *diag_;
+	float *precond_;
+	// df/dx of each spring times the relative velocity of its ends
+	Vec3LaneBuffer spring_jv_;
+
+	Vec3LaneBuffer rhs_;
+	Vec3LaneBuffer dv_;
+	Vec3LaneBuffer r_;
+	Vec3LaneBuffer z_;
+	Vec3LaneBuffer p_;
+	Vec3LaneBuffer q_;
+
+	// per thread partial sums of the dot products
+	int num_partials_;
+	double *partials_;
+
+	void assemble(const Vec3Lanes &pos, const Vec3Lanes &vel, const Vec3Lanes &forces, const float *inv_mass,
+		float mass, float k, float kv, float h, ThreadPool &pool);
+	void multiply(const Vec3Lanes &x, Vec3Lanes &y, const float *inv_mass, ThreadPool &pool);
+	void precondition(const Vec3Lanes &x, Vec3Lanes &y, ThreadPool &pool);
+	double dot(const Vec3Lanes &a, const Vec3Lanes &b, ThreadPool &pool);
+};
+
+#endif  // IMPLICIT_SOLVER_H
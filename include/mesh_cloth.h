@@ -0,0 +1,67 @@
+#ifndef MESH_CLOTH_H
+#define MESH_CLOTH_H
+
+#include "cloth.h"
+#include "vertex_order.h"
+
+/**
+ * A Cloth made from an arbitrary triangle mesh, e.g. a garment to drape. Every triangle edge is
+ * a spring whose rest length is its length in the input mesh, every triangle feels air drag.
+ *
+ * The points are stored in the given VertexOrder, by default along a Hilbert curve, so points
+ * that are close on the cloth are also close in memory for the solver and in the index buffer
+ * for the GPU vertex cache. Use PointIndex() to find an input point, e.g. to lock it.
+ */
+class MeshCloth : public Cloth {
+public:
+	MeshCloth(const glm::vec3 *points, const glm::vec2 *uvs, int num_pts, const unsigned int *indices, int num_tris,
+		float k, float kv, float mass, float drag_coef, VertexOrder order = VertexOrder::Hilbert);
+
+	~MeshCloth();
+
+	MeshCloth(const MeshCloth&) = delete;
+	MeshCloth& operator=(const MeshCloth&) = delete;
+
+	void Reorder(VertexOrder order);
+	VertexOrder GetOrder() const { return order_; }
+
+	// Index of the given input point in Positions() and the other per point arrays
+	int PointIndex(int input_index) const { return point_index_[input_index]; }
+
+	int NumSprings() const { return springs_.Size(); }
+
+protected:
+	void calcForces(Vec3Lanes &forces) override;
+	void calcExternalForces(Vec3Lanes &forces) override;
+	void calcShading(bool tangents) const override;
+	const SpringList& springList() override { return springs_; }
+
+private:
+	VertexOrder order_;
+	int *point_index_;
+
+	// springs along the unique triangle edges, sorted by their end points with a < b
+	SpringList springs_;
+
+	// springs and triangles around each point, in compressed rows. A spring is stored as s when
+	// the point is its a end and as ~s when it is its b end
+	int *point_springs_start_;
+	int *point_springs_;
+	int *point_tris_start_;
+	int *point_tris_;
+
+	// per spring force on the a end, per triangle drag on each corner
+	Vec3LaneBuffer spring_forces_;
+	Vec3LaneBuffer tri_drag_;
+	glm::vec3 *face_normals_;
+	glm::vec3 *face_tangents_;
+	// per triangle weights of its two edges in its tangent, from the inverse of its UV matrix
+	glm::vec2 *tangent_weights_;
+
+	void buildSprings();
+	void buildAdjacency();
+	void calcTangentWeights();
+	void gatherForces(Vec3Lanes &forces, bool springs);
+};
+
+#endif  // MESH_CLOTH_H
@@ -0,0 +1,88 @@
+#ifndef PARTICLE_STORE_H
+#define PARTICLE_STORE_H
+
+#include <glm/glm.hpp>
+
+// Every lane starts on a cache line and is padded to a whole number of 16 float blocks
+// (one AVX-512 register), so vector loops never need a scalar remainder loop.
+const int kLaneWidth = 16;
+const int kLaneAlignment = 64;
+
+/**
+ * Round count up to the padded length of a lane.
+ */
+inline int PaddedLaneSize(int count) {
+	return (count + kLaneWidth - 1) / kLaneWidth * kLaneWidth;
+}
+
+/**
+ * Distance in floats between the lanes of count vectors that share an allocation. Lanes a
+ * multiple of 4 KiB apart map to the same cache sets and evict each other when they are walked
+ * together, so such lanes are moved apart by one extra block.
+ */
+inline int LanePitch(int count) {
+	int padded = PaddedLaneSize(count);
+	return (padded * sizeof(float)) % 4096 == 0 ? padded + kLaneWidth : padded;
+}
+
+/**
+ * Allocate a zero-initialized, kLaneAlignment aligned array of count floats padded with
+ * PaddedLaneSize(). Free it with FreeLane().
+ */
+float* AllocateLane(int count);
+
+void FreeLane(float *lane);
+
+/**
+ * A structure-of-arrays view of count 3D vectors, each component is stored in its own lane.
+ */
+struct Vec3Lanes {
+	float *x = nullptr;
+	float *y = nullptr;
+	float *z = nullptr;
+
+	glm::vec3 Get(int i) const { return glm::vec3(x[i], y[i], z[i]); }
+
+	void Set(int i, const glm::vec3 &v) {
+		x[i] = v.x;
+		y[i] = v.y;
+		z[i] = v.z;
+	}
+
+	void Add(int i, const glm::vec3 &v) {
+		x[i] += v.x;
+		y[i] += v.y;
+		z[i] += v.z;
+	}
+};
+
+/**
+ * Owns the storage behind a Vec3Lanes. All three lanes share a single aligned allocation.
+ */
+class Vec3LaneBuffer {
+public:
+	Vec3LaneBuffer();
+
+	~Vec3LaneBuffer();
+
+	Vec3LaneBuffer(const Vec3LaneBuffer&) = delete;
+	Vec3LaneBuffer& operator=(const Vec3LaneBuffer&) = delete;
+
+	void Resize(int count);
+
+	int Size() const { return count_; }
+
+	Vec3Lanes& Lanes() { return lanes_; }
+	const Vec3Lanes& Lanes() const { return lanes_; }
+
+	// Convert to and from the array-of-structures layout used for rendering and export
+	void Load(const glm::vec3 *src);
+	void Store(glm::vec3 *dst) const;
+
+private:
+	int count_;
+	float *data_;
+	Vec3Lanes lanes_;
+};
+
+#endif  // PARTICLE_STORE_H
@@ -0,0 +1,98 @@
+#ifndef PROJECTIVE_SOLVER_H
+#define PROJECTIVE_SOLVER_H
+
+#include "particle_store.h"
+#include "sparse_cholesky.h"
+#include "spring_list.h"
+#include "thread_pool.h"
+
+/**
+ * Projective Dynamics step for a mass-spring system (Bouaziz et al., "Projective Dynamics:
+ * Fusing Constraint Projections for Fast Simulation", 2014). The step minimizes
+ *
+ *     1 / (2 h^2) |x - y|_M^2 + sum k / 2 |x_a - x_b - p_s|^2
+ *
+ * over the positions x, where y is the inertial prediction from the velocities and the external
+ * forces. The local step projects every spring onto its rest length, p_s = rest * (x_a - x_b) /
+ * |x_a - x_b|, in parallel. The global step solves
+ *
+ *     (M / h^2 + (k + kv / h) L) x = M / h^2 y + sum k p_s + damping
+ *
+ * where L is the graph Laplacian of the springs. The matrix only changes with the topology, the
+ * locked points, h, k or kv, so its Cholesky factorization is computed once and every global
+ * step costs two triangular solves, shared by the three coordinates. Damping kv / h L acts on
+ * the relative motion of the spring ends in all directions, not only along the springs like the
+ * force based integrators.
+ *
+ * Points with an inverse mass of 0 are eliminated from the system. Changing which points are
+ * locked refactors the matrix, a step otherwise does not touch the heap.
+ */
+class ProjectiveSolver {
+public:
+	ProjectiveSolver();
+
+	~ProjectiveSolver();
+
+	ProjectiveSolver(const ProjectiveSolver&) = delete;
+	ProjectiveSolver& operator=(const ProjectiveSolver&) = delete;
+
+	// Prepare for num_pts points tied by springs, call again whenever the springs change
+	void Setup(int num_pts, const SpringList &springs);
+
+	void SetIterations(int num_iterations) { num_iterations_ = num_iterations; }
+	int GetIterations() const { return num_iterations_; }
+
+	// Number of entries of the Cholesky factor, 0 before the first step
+	int FactorSize() const { return cholesky_.FactorSize(); }
+
+	/**
+	 * Advance pos and vel by h, forces holds the external forces at the start of the step.
+	 * Returns false and leaves pos and vel alone when the system matrix is not positive definite,
+	 * which takes a stiffness k + kv / h of 0 or less, or NaN parameters.
+	 */
+	bool Step(Vec3Lanes &pos, Vec3Lanes &vel, const Vec3Lanes &forces, const float *inv_mass,
+		float mass, float k, float kv, float h, ThreadPool &pool);
+
+private:
+	int num_pts_;
+	const SpringList *springs_;
+	int num_iterations_;
+
+	// springs around each point in compressed rows, s when the point is the a end, ~s otherwise
+	int *point_springs_start_;
+	int *point_springs_;
+
+	// unknown of each point, -1 for locked points, and the point of each unknown
+	int *unknown_;
+	int *unknown_point_;
+	int num_unknowns_;
+	bool analyzed_;
+
+	// the system matrix in compressed rows, as the Laplacian entries of the springs
+	int *matrix_start_;
+	int *matrix_cols_;
+	double *laplacian_;
+	double *matrix_;
+	int *diag_index_;
+	SparseCholesky cholesky_;
+	// the parameters of the current factorization
+	float factor_mass_;
+	float factor_k_;
+	float factor_kv_;
+	float factor_h_;
+	bool factored_;
+
+	Vec3LaneBuffer prev_pos_;
+	Vec3LaneBuffer inertia_;
+	// projection of each spring
+	Vec3LaneBuffer targets_;
+	// right hand sides of the three coordinates side by side, and solver scratch
+	double *rhs_;
+	double *work_;
+
+	bool locksChanged(const float *inv_mass) const;
+	void analyze(const float *inv_mass);
+	bool factor(float mass, float k, float kv, float h);
+};
+
+#endif  // PROJECTIVE_SOLVER_H
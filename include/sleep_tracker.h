@@ -0,0 +1,73 @@
+#ifndef SLEEP_TRACKER_H
+#define SLEEP_TRACKER_H
+
+#include "particle_store.h"
+#include "thread_pool.h"
+
+/**
+ * Tracks which parts of a grid cloth have settled, so the force and integration passes can skip
+ * them. The grid is split into tiles of kTileRopes ropes by kTilePoints points. A tile whose
+ * points all stay below the kinetic energy threshold, and whose free points feel a net force
+ * below the force threshold (their springs are in equilibrium, however strained), for
+ * kSleepDelay steps in a row falls asleep: its velocities are zeroed and it is frozen until it
+ * is woken up again. A tile wakes up when a neighboring awake tile moves, or through Wake().
+ */
+class SleepTracker {
+public:
+	static const int kTileRopes = 32;
+	static const int kTilePoints = 32;
+	static const int kSleepDelay = 20;
+
+	SleepTracker();
+
+	~SleepTracker();
+
+	SleepTracker(const SleepTracker&) = delete;
+	SleepTracker& operator=(const SleepTracker&) = delete;
+
+	// Split a grid of num_ropes ropes of pts_per_rope points into tiles, all of them awake
+	void Setup(int num_ropes, int pts_per_rope);
+
+	void SetThresholds(float kinetic_energy, float force);
+
+	int NumTiles() const { return num_tiles_; }
+	int NumAwake() const { return num_awake_; }
+	int AwakeTile(int a) const { return awake_list_[a]; }
+
+	// The ropes [first, last) and the points [first, last) of each rope covered by a tile
+	void TileRopes(int tile, int *first, int *last) const;
+	void TilePoints(int tile, int *first, int *last) const;
+
+	// Wake the tile of point and its neighbors
+	void Wake(int point);
+	void WakeAll();
+
+	/**
+	 * Check the awake tiles after a step, forces holds the last forces evaluated for them. Puts
+	 * the tiles that stayed quiet long enough to sleep and wakes the neighbors of moving ones.
+	 * Returns true when a tile woke up.
+	 */
+	bool Update(Vec3Lanes &vel, const Vec3Lanes &forces, const float *inv_mass, float mass, ThreadPool &pool);
+
+private:
+	int num_ropes_;
+	int pts_per_rope_;
+	int tiles_across_;
+	int tiles_along_;
+	int num_tiles_;
+	float max_kinetic_energy_;
+	float max_force_sq_;
+
+	bool *awake_;
+	// steps each awake tile has been quiet for
+	int *quiet_steps_;
+	// whether each awake tile moved during the last step
+	bool *moving_;
+	int num_awake_;
+	int *awake_list_;
+
+	void wakeTile(int tile_rope, int tile_point);
+	void rebuildAwakeList();
+};
+
+#endif  // SLEEP_TRACKER_H
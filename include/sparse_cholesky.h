@@ -0,0 +1,77 @@
+#ifndef SPARSE_CHOLESKY_H
+#define SPARSE_CHOLESKY_H
+
+/**
+ * Sparse Cholesky factorization P A P^T = L L^T of a symmetric positive definite matrix, for
+ * systems whose matrix is factored once and solved with many right hand sides.
+ *
+ * Analyze() orders the unknowns by nested dissection of the matrix graph (separators from
+ * breadth first level structures, George and Liu) to keep the fill low, and computes the
+ * elimination tree and the structure of L. Factor() computes L with an up-looking method
+ * (Davis, "Direct Methods for Sparse Linear Systems", 2006) and can be called again for new
+ * values of the same pattern without allocating. Solve() does not allocate either, and calls on
+ * different work arrays may run concurrently.
+ */
+class SparseCholesky {
+public:
+	SparseCholesky();
+
+	~SparseCholesky();
+
+	SparseCholesky(const SparseCholesky&) = delete;
+	SparseCholesky& operator=(const SparseCholesky&) = delete;
+
+	/**
+	 * Prepare for an n x n matrix given in compressed rows: row i has its column indices at
+	 * [row_start[i], row_start[i + 1]) of cols. The pattern must be symmetric, hold the diagonal
+	 * and have no duplicate entries.
+	 */
+	void Analyze(int n, const int *row_start, const int *cols);
+
+	// Factor the matrix with the pattern of Analyze() and the entries values, false if it is not
+	// positive definite or has NaN entries
+	bool Factor(const double *values);
+
+	/**
+	 * Solve A x = b in place for num_rhs right hand sides at once, which streams L through
+	 * memory once for all of them. b holds the num_rhs values of each unknown next to each
+	 * other, work is scratch space of the same size.
+	 */
+	void Solve(double *b, double *work, int num_rhs = 1) const;
+
+	int Size() const { return n_; }
+
+	// Number of entries of L, including the diagonal
+	int FactorSize() const { return n_ > 0 ? l_start_[n_] : 0; }
+
+private:
+	int n_;
+	int num_entries_;
+	// perm_[k] is the unknown eliminated k-th, inv_perm_ its inverse
+	int *perm_;
+	int *inv_perm_;
+
+	// upper triangle of P A P^T in compressed columns, and the position of each input entry in
+	// it or -1 for entries of the lower triangle
+	int *c_start_;
+	int *c_rows_;
+	double *c_values_;
+	int *value_map_;
+
+	int *parent_;
+	// L in compressed columns, the diagonal first in each column
+	int *l_start_;
+	int *l_rows_;
+	double *l_values_;
+
+	// scratch of Factor()
+	int *l_next_;
+	int *stack_;
+	int *flag_;
+	double *x_;
+
+	void order(const int *row_start, const int *cols);
+	int reach(int k, int *stack);
+};
+
+#endif  // SPARSE_CHOLESKY_H
@@ -0,0 +1,85 @@
+#ifndef SPRING_KERNELS_H
+#define SPRING_KERNELS_H
+
+#include <cmath>
+
+/**
+ * A run of n structural springs. Spring i ties point a + i to point b + i, the pointers below
+ * already point at the first a and b end. The kernels write the force acting on the a end of
+ * each spring into f, the b end receives the opposite force.
+ */
+struct SpringRun {
+	const float *ax, *ay, *az;
+	const float *bx, *by, *bz;
+	const float *vax, *vay, *vaz;
+	const float *vbx, *vby, *vbz;
+	float *fx, *fy, *fz;
+	int n;
+	float k;
+	float kv;
+	float rest_length;
+};
+
+/**
+ * Instruction sets with a dedicated spring kernel, ordered from least to most capable.
+ */
+enum class SimdLevel {
+	Scalar,
+	SSE42,
+	AVX2,
+	AVX512
+};
+
+typedef void (*SpringRunKernel)(const SpringRun &run);
+
+/**
+ * The best instruction set supported by both this build and the CPU we are running on.
+ */
+SimdLevel DetectSimdLevel();
+
+/**
+ * The kernel for the given level. Levels that are not compiled into this build fall back to
+ * the next best one, ending with the scalar reference kernel.
+ */
+SpringRunKernel SelectSpringKernel(SimdLevel level);
+
+const char* SimdLevelName(SimdLevel level);
+
+// Reference implementation, every vector kernel must match it up to rounding
+void SpringRunScalar(const SpringRun &run);
+
+#ifdef CLOTHSIM_X86_KERNELS
+void SpringRunSSE42(const SpringRun &run);
+void SpringRunAVX2(const SpringRun &run);
+void SpringRunAVX512(const SpringRun &run);
+#endif
+
+/**
+ * Evaluate springs [begin, end) of a run one at a time. The vector kernels use this for the
+ * remainder of a run, it is static so every kernel gets a copy built with its own flags.
+ */
+static inline void springRunRange(const SpringRun &run, int begin, int end) {
+	for (int i = begin; i < end; ++i) {
+		float dx = run.ax[i] - run.bx[i];
+		float dy = run.ay[i] - run.by[i];
+		float dz = run.az[i] - run.bz[i];
+		float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+		float string_force = -run.k * (length - run.rest_length);
+
+		// velocity spring force here
+		float inv_length = 1.0f / length;
+		dx *= inv_length;
+		dy *= inv_length;
+		dz *= inv_length;
+		float rel_vel = (run.vax[i] - run.vbx[i]) * dx + (run.vay[i] - run.vby[i]) * dy + (run.vaz[i] - run.vbz[i]) * dz;
+		float damp_force = -run.kv * rel_vel;
+
+		// combine it all together
+		float force = string_force + damp_force;
+		run.fx[i] = dx * force;
+		run.fy[i] = dy * force;
+		run.fz[i] = dz * force;
+	}
+}
+
+#endif  // SPRING_KERNELS_H
@@ -0,0 +1,42 @@
+#ifndef SPRING_LIST_H
+#define SPRING_LIST_H
+
+/**
+ * An explicit list of springs, spring s ties point A()[s] to point B()[s] and is at rest at
+ * length Rest()[s]. The grid kernels never need one, the solvers that work on any mesh do.
+ */
+class SpringList {
+public:
+	SpringList();
+
+	~SpringList();
+
+	SpringList(const SpringList&) = delete;
+	SpringList& operator=(const SpringList&) = delete;
+
+	// Resize the list to count springs, the contents are lost whenever the size changes
+	void Resize(int count);
+
+	int Size() const { return count_; }
+
+	void Set(int s, int a, int b, float rest) {
+		a_[s] = a;
+		b_[s] = b;
+		rest_[s] = rest;
+	}
+
+	int* A() { return a_; }
+	const int* A() const { return a_; }
+	int* B() { return b_; }
+	const int* B() const { return b_; }
+	float* Rest() { return rest_; }
+	const float* Rest() const { return rest_; }
+
+private:
+	int count_;
+	int *a_;
+	int *b_;
+	float *rest_;
+};
+
+#endif  // SPRING_LIST_H
@@ -0,0 +1,71 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads for data parallel loops. ParallelFor() splits a range into one
+ * contiguous chunk per thread, the calling thread works on the first chunk itself. Running a
+ * loop does not allocate, so the pool can be used inside an allocation-free step.
+ */
+class ThreadPool {
+public:
+	// num_threads counts the calling thread, a pool of 1 runs everything inline
+	explicit ThreadPool(int num_threads);
+
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	int NumThreads() const { return num_threads_; }
+
+	/**
+	 * Call fn(first, last, thread) for disjoint chunks covering [begin, end) and wait for all of
+	 * them. thread is in [0, NumThreads()) and can be used to pick per-thread scratch memory.
+	 */
+	template <typename Fn>
+	void ParallelFor(int begin, int end, const Fn &fn) {
+		if (end <= begin) {
+			return;
+		}
+		if (num_threads_ == 1 || end - begin == 1) {
+			fn(begin, end, 0);
+			return;
+		}
+		run(begin, end, &invoke<Fn>, &fn);
+	}
+
+private:
+	typedef void (*Task)(const void *fn, int first, int last, int thread);
+
+	template <typename Fn>
+	static void invoke(const void *fn, int first, int last, int thread) {
+		(*static_cast<const Fn*>(fn))(first, last, thread);
+	}
+
+	int num_threads_;
+	std::vector<std::thread> workers_;
+
+	std::mutex mutex_;
+	std::condition_variable start_cv_;
+	std::condition_variable done_cv_;
+	// incremented for every loop so sleeping workers can tell a new loop from a spurious wake up
+	unsigned long generation_;
+	int pending_;
+	bool stop_;
+
+	Task task_;
+	const void *task_fn_;
+	int begin_;
+	int end_;
+
+	void run(int begin, int end, Task task, const void *fn);
+	void chunk(int thread, int *first, int *last) const;
+	void workerLoop(int thread);
+};
+
+#endif  // THREAD_POOL_H
@@ -0,0 +1,114 @@
+#ifndef VERTEX_FORMATS_H
+#define VERTEX_FORMATS_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+/**
+ * The per point attributes that change every step, interleaved for the dynamic vertex stream
+ * of a renderer.
+ */
+struct RenderVertex {
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec3 tangent;
+};
+
+/**
+ * RenderVertex in 16 bytes instead of 36. The position is stored as 16 bit unsigned
+ * normalized coordinates inside a quantization box given with every batch of vertices, the
+ * fourth component is padding. The normal and the tangent are octahedral encoded into two
+ * 16 bit signed normalized components each.
+ */
+struct CompactVertex {
+	uint16_t position[4];
+	int16_t normal[2];
+	int16_t tangent[2];
+};
+
+/**
+ * RenderVertex and CompactVertex without the tangent, 24 and 12 bytes, for shaders that do not
+ * read it.
+ */
+struct RenderVertexNoTangent {
+	glm::vec3 position;
+	glm::vec3 normal;
+};
+
+struct CompactVertexNoTangent {
+	uint16_t position[4];
+	int16_t normal[2];
+};
+
+/**
+ * Clamp value to [lower, upper], a NaN becomes lower.
+ */
+inline float ClampQuantized(float value, float lower, float upper) {
+	return !(value >= lower) ? lower : (value > upper ? upper : value);
+}
+
+/**
+ * Map a unit vector onto the octahedron |x| + |y| + |z| = 1 and unfold the lower half over the
+ * upper one, the result is stored as two signed normalized shorts. A zero or invalid vector
+ * encodes as +z.
+ */
+inline void OctahedralEncode(const glm::vec3 &v, int16_t *out) {
+	float l1 = std::fabs(v.x) + std::fabs(v.y) + std::fabs(v.z);
+	float x = 0.0f;
+	float y = 0.0f;
+	if (l1 > 0.0f) {
+		float inv_l1 = 1.0f / l1;
+		x = v.x * inv_l1;
+		y = v.y * inv_l1;
+		if (v.z < 0.0f) {
+			float folded_x = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			y = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = folded_x;
+		}
+	}
+	// the bias rounds to nearest
+	x = ClampQuantized(x, -1.0f, 1.0f) * 32767.0f;
+	y = ClampQuantized(y, -1.0f, 1.0f) * 32767.0f;
+	out[0] = (int16_t)(x + (x >= 0.0f ? 0.5f : -0.5f));
+	out[1] = (int16_t)(y + (y >= 0.0f ? 0.5f : -0.5f));
+}
+
+/**
+ * Round a float to the nearest IEEE half, ties to even, values beyond the half range become
+ * infinite.
+ */
+inline uint16_t FloatToHalf(float value) {
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+	uint32_t mantissa = bits & 0x7fffff;
+	if (exponent >= 31) {
+		// overflow, infinity or NaN
+		bool nan = ((bits >> 23) & 0xff) == 0xff && mantissa != 0;
+		return (uint16_t)(sign | 0x7c00 | (nan ? 0x200 : 0));
+	}
+	if (exponent <= 0) {
+		if (exponent < -10) {
+			return sign;
+		}
+		// subnormal half
+		mantissa |= 0x800000;
+		int shift = 14 - exponent;
+		uint32_t half_mantissa = mantissa >> shift;
+		uint32_t half_bit = 1u << (shift - 1);
+		uint32_t rest = mantissa & ((half_bit << 1) - 1);
+		if (rest > half_bit || (rest == half_bit && (half_mantissa & 1))) {
+			++half_mantissa;
+		}
+		return (uint16_t)(sign | half_mantissa);
+	}
+	// round to nearest even, a carry into the exponent is still the correct result
+	uint32_t rounded = mantissa + 0xfff + ((mantissa >> 13) & 1);
+	return (uint16_t)(sign | ((exponent << 10) + (rounded >> 13)));
+}
+
+#endif  // VERTEX_FORMATS_H
@@ -0,0 +1,25 @@
+#ifndef VERTEX_ORDER_H
+#define VERTEX_ORDER_H
+
+#include <glm/glm.hpp>
+
+/**
+ * Orders in which the points of a MeshCloth can be stored. The space filling curves keep
+ * points that are close in space close in memory too.
+ */
+enum class VertexOrder {
+	Input,
+	Morton,
+	Hilbert
+};
+
+const char* VertexOrderName(VertexOrder order);
+
+/**
+ * Sort num_pts points along the curve through their bounding box, new_index[i] receives the
+ * position of point i in the sorted order. Points with the same curve key keep their relative
+ * order, VertexOrder::Input leaves every point in place.
+ */
+void SpaceFillingCurveOrder(const glm::vec3 *points, int num_pts, VertexOrder order, int *new_index);
+
+#endif  // VERTEX_ORDER_H
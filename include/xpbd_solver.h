@@ -0,0 +1,60 @@
+#ifndef XPBD_SOLVER_H
+#define XPBD_SOLVER_H
+
+#include "particle_store.h"
+#include "spring_list.h"
+#include "thread_pool.h"
+
+/**
+ * Extended position based dynamics (Macklin, Müller and Chentanez, "XPBD: Position-Based
+ * Simulation of Compliant Constrained Dynamics", 2016). Every spring becomes a distance
+ * constraint with a compliance of 1 / k and constraint damping from kv. A step predicts the
+ * positions from the external forces and then runs a fixed number of Gauss-Seidel sweeps over
+ * the constraints, so its cost does not depend on the stiffness. Like for the force based
+ * integrators, a k of 0 or less means no spring force: the constraints are then not projected
+ * at all, a zero compliance would make them rigid instead.
+ *
+ * The constraints are greedily colored so no two constraints of a color share a point. The
+ * constraints of one color are projected in parallel, the colors one after another.
+ */
+class XpbdSolver {
+public:
+	XpbdSolver();
+
+	~XpbdSolver();
+
+	XpbdSolver(const XpbdSolver&) = delete;
+	XpbdSolver& operator=(const XpbdSolver&) = delete;
+
+	// Prepare for num_pts points tied by springs, call again whenever the springs change
+	void Setup(int num_pts, const SpringList &springs);
+
+	void SetIterations(int num_iterations) { num_iterations_ = num_iterations; }
+	int GetIterations() const { return num_iterations_; }
+
+	int NumColors() const { return num_colors_; }
+
+	/**
+	 * Advance pos and vel by h, forces holds the external forces. Points with an inverse mass
+	 * of 0 do not move.
+	 */
+	void Step(Vec3Lanes &pos, Vec3Lanes &vel, const Vec3Lanes &forces, const float *inv_mass,
+		float k, float kv, float h, ThreadPool &pool);
+
+private:
+	int num_pts_;
+	int num_iterations_;
+
+	// the constraints sorted by color, color c is [color_start_[c], color_start_[c + 1])
+	int num_constraints_;
+	int num_colors_;
+	int *color_start_;
+	int *constraint_a_;
+	int *constraint_b_;
+	float *constraint_rest_;
+	float *lambda_;
+
+	Vec3LaneBuffer prev_pos_;
+};
+
+#endif  // XPBD_SOLVER_H
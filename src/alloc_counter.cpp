@@ -0,0 +1,71 @@
+#include "alloc_counter.h"
+
+#ifdef CLOTHSIM_COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<size_t> num_allocations(0);
+
+static void* countedAlloc(size_t size) {
+	num_allocations.fetch_add(1, std::memory_order_relaxed);
+	void *ptr = std::malloc(size == 0 ? 1 : size);
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void* operator new(size_t size) {
+	return countedAlloc(size);
+}
+
+void* operator new[](size_t size) {
+	return countedAlloc(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	num_allocations.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	num_allocations.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+size_t HeapAllocationCount() {
+	return num_allocations.load(std::memory_order_relaxed);
+}
+
+void RecordHeapAllocation() {
+	num_allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+#else
+
+size_t HeapAllocationCount() {
+	return 0;
+}
+
+void RecordHeapAllocation() {
+}
+
+#endif  // CLOTHSIM_COUNT_ALLOCATIONS
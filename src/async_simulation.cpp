@@ -0,0 +1,77 @@
+#include "async_simulation.h"
+
+#include <algorithm>
+
+AsyncSimulation::AsyncSimulation(Cloth &cloth, float frame_dt, float frames_per_second) : cloth_(cloth),
+	frame_dt_(frame_dt), period_(std::chrono::steady_clock::duration::zero()), back_(0), front_(1),
+	shared_(2), paused_(true), stop_(false), frame_count_(0) {
+	if (frames_per_second > 0.0f) {
+		period_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(1.0 / frames_per_second));
+	}
+	for (int s = 0; s < 3; ++s) {
+		slots_[s] = new glm::vec3[cloth_.NumPoints()];
+		std::copy(cloth_.Positions(), cloth_.Positions() + cloth_.NumPoints(), slots_[s]);
+	}
+	thread_ = std::thread(&AsyncSimulation::run, this);
+}
+
+AsyncSimulation::~AsyncSimulation() {
+	stop_.store(true, std::memory_order_relaxed);
+	thread_.join();
+	for (int s = 0; s < 3; ++s) {
+		delete [] slots_[s];
+	}
+}
+
+/**
+ * Mirror the latest frame published by the simulation thread in display, a cloth built like the
+ * simulated one, through Cloth::SetPositions(). Returns false and leaves display alone when no
+ * frame was published since the last call. Call it from one thread only, usually the render
+ * thread before ClothRenderer::Update().
+ */
+bool AsyncSimulation::Acquire(Cloth &display) {
+	if (!(shared_.load(std::memory_order_relaxed) & kFresh)) {
+		return false;
+	}
+	// acquire the frame written into the new slot, release our reads of the old one
+	front_ = shared_.exchange(front_, std::memory_order_acq_rel) & kSlotMask;
+	display.SetPositions(slots_[front_]);
+	return true;
+}
+
+/**
+ * Simulation thread: advance one frame per period, or as fast as possible without one. A frame
+ * that takes longer than the period moves the schedule back instead of running the next ones
+ * back to back to catch up.
+ */
+void AsyncSimulation::run() {
+	std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+	while (!stop_.load(std::memory_order_relaxed)) {
+		if (paused_.load(std::memory_order_relaxed)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			next = std::chrono::steady_clock::now();
+			continue;
+		}
+		cloth_.Advance(frame_dt_);
+		publish();
+		frame_count_.fetch_add(1, std::memory_order_relaxed);
+
+		next += period_;
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (next > now) {
+			std::this_thread::sleep_until(next);
+		} else {
+			next = now;
+		}
+	}
+}
+
+/**
+ * Copy the cloth's positions into the back slot and swap it into the shared slot.
+ */
+void AsyncSimulation::publish() {
+	std::copy(cloth_.Positions(), cloth_.Positions() + cloth_.NumPoints(), slots_[back_]);
+	// release the positions just written, acquire the slot Acquire() gave back
+	back_ = shared_.exchange(back_ | kFresh, std::memory_order_acq_rel) & kSlotMask;
+}
@@ -0,0 +1,427 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "cloth.h"
+#include "grid_cloth.h"
+#include "mesh_cloth.h"
+
+/**
+ * Counts the last level cache misses of this process with the Linux perf events, elsewhere or
+ * when the kernel does not allow it Valid() is false.
+ */
+class CacheMissCounter {
+public:
+	CacheMissCounter() : fd_(-1) {
+#ifdef __linux__
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.inherit = 1;
+		fd_ = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+	}
+
+	~CacheMissCounter() {
+#ifdef __linux__
+		if (fd_ >= 0) {
+			close(fd_);
+		}
+#endif
+	}
+
+	bool Valid() const { return fd_ >= 0; }
+
+	void Start() {
+#ifdef __linux__
+		if (fd_ >= 0) {
+			ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+	}
+
+	long long Stop() {
+		long long count = 0;
+#ifdef __linux__
+		if (fd_ >= 0) {
+			ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+			if (read(fd_, &count, sizeof(count)) != sizeof(count)) {
+				count = 0;
+			}
+		}
+#endif
+		return count;
+	}
+
+private:
+	int fd_;
+};
+
+struct StepTiming {
+	double ms_per_step;
+	// negative when the cache misses could not be counted
+	double misses_per_step;
+};
+
+/**
+ * Step a cloth and report the average time per Update(). The first row of points is locked so
+ * the cloth hangs like the flag in the viewer.
+ */
+static StepTiming timeSteps(Cloth &cloth, int num_steps) {
+	for (int i = 0; i < cloth.NumRopes(); ++i) {
+		cloth.LockNode(i, 0, true);
+	}
+	// warm up the caches and the workspace
+	cloth.Update(0.1f);
+
+	CacheMissCounter misses;
+	misses.Start();
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < num_steps; ++i) {
+		cloth.Update(0.1f);
+	}
+	auto end = std::chrono::steady_clock::now();
+	long long num_misses = misses.Stop();
+
+	StepTiming timing;
+	timing.ms_per_step = std::chrono::duration<double, std::milli>(end - start).count() / num_steps;
+	timing.misses_per_step = misses.Valid() ? (double)num_misses / num_steps : -1.0;
+	return timing;
+}
+
+/**
+ * Time a square cloth of the given size.
+ */
+static StepTiming timeSteps(int size, int num_steps, int num_threads, ForceMode mode, int tile_size) {
+	Cloth cloth(size, size, 6.5f, 2.25f, 0.75f, 1.f, 1.5f, -5.f, 24.f, 5.f, mode);
+	cloth.SetThreadCount(num_threads);
+	cloth.SetTileSize(tile_size);
+	return timeSteps(cloth, num_steps);
+}
+
+static const char* modeName(ForceMode mode) {
+	switch (mode) {
+	case ForceMode::Gather:
+		return "gather";
+	case ForceMode::Fused:
+		return "fused";
+	default:
+		return "scatter";
+	}
+}
+
+static const char* integratorName(Integrator integrator) {
+	switch (integrator) {
+	case Integrator::SymplecticEuler:
+		return "symplectic Euler";
+	case Integrator::PositionVerlet:
+		return "position Verlet";
+	case Integrator::VelocityVerlet:
+		return "velocity Verlet";
+	default:
+		return "improved Euler";
+	}
+}
+
+static ForceMode parseMode(const char *name) {
+	if (std::strcmp(name, "gather") == 0) {
+		return ForceMode::Gather;
+	}
+	if (std::strcmp(name, "fused") == 0) {
+		return ForceMode::Fused;
+	}
+	return ForceMode::Scatter;
+}
+
+static void printTiming(const StepTiming &timing) {
+	std::cout << timing.ms_per_step << " ms/step";
+	if (timing.misses_per_step >= 0.0) {
+		std::cout << ", " << (long long)timing.misses_per_step << " cache misses/step";
+	}
+	std::cout << std::endl;
+}
+
+/**
+ * tile_size is passed to Cloth::SetTileSize(), a size of 0 picks one from the cache sizes.
+ */
+static void report(int size, int num_steps, int num_threads, ForceMode mode, int tile_size = 0) {
+	StepTiming timing = timeSteps(size, num_steps, num_threads, mode, tile_size);
+	std::cout << size << "x" << size << ", " << modeName(mode) << ", "
+		<< (num_threads < 1 ? std::string("all") : std::to_string(num_threads)) << " thread(s), tile "
+		<< (tile_size < 1 ? std::string("auto") : std::to_string(tile_size)) << ": ";
+	printTiming(timing);
+}
+
+/**
+ * The same as report() for a GridCloth of the given size, with the automatic tile size.
+ */
+template <int N>
+static void reportGrid(int num_steps, int num_threads, ForceMode mode) {
+	GridCloth<N, N> cloth(6.5f, 2.25f, 0.75f, 1.f, 1.5f, -5.f, 24.f, 5.f, mode);
+	cloth.SetThreadCount(num_threads);
+	StepTiming timing = timeSteps(cloth, num_steps);
+	std::cout << N << "x" << N << " GridCloth, " << modeName(mode) << ", "
+		<< (num_threads < 1 ? std::string("all") : std::to_string(num_threads)) << " thread(s): ";
+	printTiming(timing);
+}
+
+/**
+ * Step a square grid imported as a MeshCloth whose points come in random order, like a mesh
+ * from a modeling tool, and stored in the given order.
+ */
+static void reportMesh(int size, int num_steps, VertexOrder order) {
+	Cloth grid(size, size, 6.5f, 2.25f, 0.75f, 1.f, 1.5f, -5.f, 24.f, 5.f);
+	int num_pts = grid.NumPoints();
+	std::vector<int> shuffled(num_pts);
+	for (int i = 0; i < num_pts; ++i) {
+		shuffled[i] = i;
+	}
+	std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(1));
+	std::vector<glm::vec3> points(num_pts);
+	std::vector<glm::vec2> uvs(num_pts);
+	for (int i = 0; i < num_pts; ++i) {
+		points[shuffled[i]] = grid.Positions()[i];
+		uvs[shuffled[i]] = grid.UVs()[i];
+	}
+	std::vector<unsigned int> indices(3 * grid.NumTriangles());
+	for (size_t i = 0; i < indices.size(); ++i) {
+		indices[i] = shuffled[grid.Indices()[i]];
+	}
+
+	MeshCloth cloth(points.data(), uvs.data(), num_pts, indices.data(), grid.NumTriangles(),
+		6.5f, 2.25f, 0.75f, 1.5f, order);
+	for (int i = 0; i < size; ++i) {
+		cloth.LockPoint(cloth.PointIndex(shuffled[i * size]), true);
+	}
+	cloth.Update(0.1f);
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < num_steps; ++i) {
+		cloth.Update(0.1f);
+	}
+	auto end = std::chrono::steady_clock::now();
+	std::cout << size << "x" << size << " mesh, " << VertexOrderName(order) << " order: "
+		<< std::chrono::duration<double, std::milli>(end - start).count() / num_steps << " ms/step" << std::endl;
+}
+
+/**
+ * Step a cloth with spring constant k with Integrator::BackwardEuler at the viewer's timestep.
+ */
+static void reportImplicit(int size, int num_steps, float k) {
+	Cloth cloth(size, size, k, 2.25f, 0.75f, 1.f, 1.5f, -5.f, 24.f, 5.f);
+	cloth.SetIntegrator(Integrator::BackwardEuler);
+	for (int i = 0; i < size; ++i) {
+		cloth.LockNode(i, 0, true);
+	}
+	cloth.Update(0.1f);
+	int num_iterations = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < num_steps; ++i) {
+		cloth.Update(0.1f);
+		num_iterations += cloth.Stats().solver_iterations;
+	}
+	auto end = std::chrono::steady_clock::now();
+	std::cout << size << "x" << size << ", backward Euler, k " << k << ": "
+		<< std::chrono::duration<double, std::milli>(end - start).count() / num_steps << " ms/step, "
+		<< (double)num_iterations / num_steps << " CG iterations/step" << std::endl;
+}
+
+/**
+ * Time an integrator with a fixed iteration count, XPBD or Projective Dynamics. The first step is
+ * left out, it sets up the solver.
+ */
+static void reportConstraints(int size, int num_steps, float k, Integrator integrator, int num_iterations) {
+	Cloth cloth(size, size, k, 2.25f, 0.75f, 1.f, 1.5f, -5.f, 24.f, 5.f);
+	cloth.SetIntegrator(integrator);
+	cloth.SetConstraintIterations(num_iterations);
+	for (int i = 0; i < size; ++i) {
+		cloth.LockNode(i, 0, true);
+	}
+	cloth.Update(0.1f);
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < num_steps; ++i) {
+		cloth.Update(0.1f);
+	}
+	auto end = std::chrono::steady_clock::now();
+	std::cout << size << "x" << size << ", " << (integrator == Integrator::XPBD ? "XPBD" : "projective dynamics")
+		<< ", k " << k << ", " << num_iterations << " iterations: "
+		<< std::chrono::duration<double, std::milli>(end - start).count() / num_steps << " ms/step" << std::endl;
+}
+
+/**
+ * Time an explicit integrator on an undamped cloth without air drag, whose energy should stay
+ * constant, and report how far it strays from the initial energy.
+ */
+static void reportEnergy(int size, int num_steps, Integrator integrator) {
+	Cloth cloth(size, size, 6.5f, 0.f, 0.75f, 1.f, 0.f, -5.f, 24.f, 5.f);
+	cloth.SetIntegrator(integrator);
+	for (int i = 0; i < size; ++i) {
+		cloth.LockNode(i, 0, true);
+	}
+	double start_energy = cloth.Energy();
+	double max_drift = 0.0;
+	std::chrono::steady_clock::duration elapsed(0);
+	for (int i = 0; i < num_steps; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		cloth.Update(0.1f);
+		elapsed += std::chrono::steady_clock::now() - start;
+		max_drift = std::max(max_drift, std::abs(cloth.Energy() - start_energy));
+	}
+	std::cout << size << "x" << size << ", " << integratorName(integrator) << ": "
+		<< std::chrono::duration<double, std::milli>(elapsed).count() / num_steps << " ms/step, energy drift "
+		<< 100.0 * (cloth.Energy() - start_energy) / start_energy << "% at the end, "
+		<< 100.0 * max_drift / start_energy << "% at most" << std::endl;
+}
+
+/**
+ * Let a cloth held at all four edges sag and settle with sleeping enabled, and report the
+ * fraction of awake tiles over the run and the cost of a step once it has settled.
+ */
+static void reportSleeping(int size, int num_steps) {
+	Cloth cloth(size, size, 6.5f, 2.25f, 0.75f, 1.f, 1.5f, -5.f, 24.f, 5.f);
+	cloth.SetSleeping(true);
+	for (int i = 0; i < size; ++i) {
+		cloth.LockNode(i, 0, true);
+		cloth.LockNode(i, size - 1, true);
+		cloth.LockNode(0, i, true);
+		cloth.LockNode(size - 1, i, true);
+	}
+	double awake_fraction = 0.0;
+	double changed_fraction = 0.0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < num_steps; ++i) {
+		cloth.Update(0.1f);
+		awake_fraction += (double)cloth.Stats().awake_tiles / cloth.Stats().total_tiles;
+		// the points ClothRenderer::Update() sends again after this step
+		int changed_pts = 0;
+		for (int b = 0; b < cloth.NumChangeBlocks(); ++b) {
+			if (cloth.BlockChangeStep(b) == cloth.StepCount()) {
+				changed_pts += cloth.BlockStart(b + 1) - cloth.BlockStart(b);
+			}
+		}
+		changed_fraction += (double)changed_pts / cloth.NumPoints();
+	}
+	auto end = std::chrono::steady_clock::now();
+	const int settled_steps = 100;
+	for (int i = 0; i < settled_steps; ++i) {
+		cloth.Update(0.1f);
+	}
+	auto settled_end = std::chrono::steady_clock::now();
+	std::cout << size << "x" << size << ", sleeping: " << std::chrono::duration<double, std::milli>(end - start).count() / num_steps
+		<< " ms/step, " << 100.0 * awake_fraction / num_steps << "% of the tiles awake on average, then "
+		<< 100.0 * cloth.Stats().awake_tiles / cloth.Stats().total_tiles << "% awake at "
+		<< std::chrono::duration<double, std::milli>(settled_end - end).count() / settled_steps << " ms/step" << std::endl;
+	std::cout << "  " << 100.0 * changed_fraction / num_steps << "% of the points uploaded per step on average, "
+		<< 36.0 * size * size * changed_fraction / num_steps / 1024 << " KB/step instead of "
+		<< 44.0 * size * size / 1024 << " KB/step for a full upload" << std::endl;
+}
+
+/**
+ * Run frames of several substeps each and report the cost of a frame when the normals and
+ * tangents are computed once per frame, as ClothRenderer::Update() does, against once per
+ * substep.
+ */
+static void reportSubsteps(int size, int num_frames, int substeps) {
+	double ms_per_frame[2];
+	for (int per_substep = 0; per_substep < 2; ++per_substep) {
+		Cloth cloth(size, size, 6.5f, 2.25f, 0.75f, 1.f, 1.5f, -5.f, 24.f, 5.f);
+		for (int i = 0; i < size; ++i) {
+			cloth.LockNode(i, 0, true);
+		}
+		cloth.Update(0.1f);
+		cloth.UpdateShading();
+		auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < num_frames; ++frame) {
+			for (int s = 0; s < substeps; ++s) {
+				cloth.Update(0.1f / substeps);
+				if (per_substep) {
+					cloth.UpdateShading();
+				}
+			}
+			cloth.UpdateShading();
+		}
+		auto end = std::chrono::steady_clock::now();
+		ms_per_frame[per_substep] = std::chrono::duration<double, std::milli>(end - start).count() / num_frames;
+	}
+	std::cout << size << "x" << size << ", " << substeps << " substeps per frame: " << ms_per_frame[0]
+		<< " ms/frame shading once per frame, " << ms_per_frame[1] << " ms/frame shading every substep" << std::endl;
+}
+
+/**
+ * Headless throughput benchmark for the cloth solver.
+ * Usage: clothsim_bench [size] [num_steps] [num_threads] [scatter|gather|fused] [tile_size]
+ * Without arguments a 256x256 and a 1024x1024 cloth are measured with every force mode, on one
+ * thread and on every hardware thread, the 256x256 one also as a GridCloth<256, 256> in the
+ * gather and fused modes, followed by a 2048x2048 cloth with and without tiling.
+ * On Linux the last level cache misses are reported too. Last, a shuffled 512x512 MeshCloth
+ * is measured in each vertex order, and a 256x256 cloth with the implicit integrator at the
+ * default and at a high stiffness, and a stiff one with XPBD and with Projective Dynamics. Then the explicit integrators are compared by cost and energy
+ * drift, a settling cloth is run with sleeping tiles, and frames of several substeps are timed
+ * with the normals computed once per frame and once per substep.
+ */
+int main(int argc, char* argv[]) {
+	std::cout << "spring kernels: " << SimdLevelName(DetectSimdLevel()) << std::endl;
+	if (argc > 1) {
+		int size = std::atoi(argv[1]);
+		int num_steps = argc > 2 ? std::atoi(argv[2]) : 50;
+		int num_threads = argc > 3 ? std::atoi(argv[3]) : 1;
+		ForceMode mode = argc > 4 ? parseMode(argv[4]) : ForceMode::Scatter;
+		int tile_size = argc > 5 ? std::atoi(argv[5]) : 0;
+		report(size, num_steps, num_threads, mode, tile_size);
+		return 0;
+	}
+	const int sizes[2] = { 256, 1024 };
+	const int steps[2] = { 100, 10 };
+	for (int i = 0; i < 2; ++i) {
+		for (int num_threads = 1; num_threads >= 0; --num_threads) {
+			report(sizes[i], steps[i], num_threads, ForceMode::Scatter);
+			report(sizes[i], steps[i], num_threads, ForceMode::Gather);
+			report(sizes[i], steps[i], num_threads, ForceMode::Fused);
+			if (sizes[i] == 256) {
+				reportGrid<256>(steps[i], num_threads, ForceMode::Gather);
+				reportGrid<256>(steps[i], num_threads, ForceMode::Fused);
+			}
+		}
+	}
+	// whole ropes against the tiled traversal
+	const int large_size = 2048;
+	report(large_size, 3, 0, ForceMode::Gather, large_size);
+	report(large_size, 3, 0, ForceMode::Gather, large_size / 2);
+
+	reportMesh(512, 10, VertexOrder::Input);
+	reportMesh(512, 10, VertexOrder::Morton);
+	reportMesh(512, 10, VertexOrder::Hilbert);
+
+	reportImplicit(256, 20, 6.5f);
+	reportImplicit(256, 20, 500.f);
+	reportConstraints(256, 20, 500.f, Integrator::XPBD, 10);
+	reportConstraints(256, 20, 5000.f, Integrator::XPBD, 10);
+	reportConstraints(256, 10, 5000.f, Integrator::ProjectiveDynamics, 10);
+
+	reportEnergy(128, 1000, Integrator::ImprovedEuler);
+	reportEnergy(128, 1000, Integrator::SymplecticEuler);
+	reportEnergy(128, 1000, Integrator::PositionVerlet);
+	reportEnergy(128, 1000, Integrator::VelocityVerlet);
+
+	reportSleeping(128, 3000);
+	reportSubsteps(256, 20, 4);
+	return 0;
+}
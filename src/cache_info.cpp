@@ -0,0 +1,82 @@
+#include "cache_info.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <vector>
+#elif defined(__APPLE__)
+#include <sys/sysctl.h>
+#include <sys/types.h>
+#else
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+static CacheSizes queryCacheSizes() {
+	CacheSizes sizes;
+	DWORD length = 0;
+	GetLogicalProcessorInformation(nullptr, &length);
+	if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) {
+		return sizes;
+	}
+	std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+	if (!GetLogicalProcessorInformation(info.data(), &length)) {
+		return sizes;
+	}
+	for (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION &entry : info) {
+		if (entry.Relationship != RelationCache) {
+			continue;
+		}
+		const CACHE_DESCRIPTOR &cache = entry.Cache;
+		if (cache.Level == 1 && (cache.Type == CacheData || cache.Type == CacheUnified)) {
+			sizes.l1d = cache.Size;
+		} else if (cache.Level == 2) {
+			sizes.l2 = cache.Size;
+		} else if (cache.Level == 3) {
+			sizes.l3 = cache.Size;
+		}
+	}
+	return sizes;
+}
+#elif defined(__APPLE__)
+static size_t sysctlSize(const char *name) {
+	long long value = 0;
+	size_t length = sizeof(value);
+	if (sysctlbyname(name, &value, &length, nullptr, 0) != 0 || value < 0) {
+		return 0;
+	}
+	return (size_t)value;
+}
+
+static CacheSizes queryCacheSizes() {
+	CacheSizes sizes;
+	sizes.l1d = sysctlSize("hw.l1dcachesize");
+	sizes.l2 = sysctlSize("hw.l2cachesize");
+	sizes.l3 = sysctlSize("hw.l3cachesize");
+	return sizes;
+}
+#else
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+static size_t sysconfSize(int name) {
+	long value = sysconf(name);
+	return value > 0 ? (size_t)value : 0;
+}
+#endif
+
+/**
+ * glibc reads the sizes from CPUID or sysfs, other C libraries may not define the names at all.
+ */
+static CacheSizes queryCacheSizes() {
+	CacheSizes sizes;
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+	sizes.l1d = sysconfSize(_SC_LEVEL1_DCACHE_SIZE);
+	sizes.l2 = sysconfSize(_SC_LEVEL2_CACHE_SIZE);
+	sizes.l3 = sysconfSize(_SC_LEVEL3_CACHE_SIZE);
+#endif
+	return sizes;
+}
+#endif
+
+const CacheSizes& DetectCacheSizes() {
+	static const CacheSizes sizes = queryCacheSizes();
+	return sizes;
+}
@@ -1,29 +1,43 @@
 #include "cloth.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <memory>
-#include <fstream>
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include <thread>
+#include <vector>
 
-#include "config.h"
+#include "alloc_counter.h"
+#include "cache_info.h"
+#include "force_kernels.h"
+
+// Bytes of lanes and scratch touched per point of a rope segment in the tiled gather: position
+// and velocity of three ropes, the forces and seven scratch entries
+static const int kTileBytesPerPoint = 3 * 24 + 12 + 7 * 12;
 
 /**
  * Create a cloth simulation using the provided force constants. By default, this constructor intializes the
  * cloth as a rectangular piece of fabric with num_ropes points in the x direction and num_columns points
- * in the y direction.
+ * in the y direction. force_mode picks how the spring and drag forces are evaluated.
  */ 
 Cloth::Cloth(int num_ropes, int num_columns, float k, float kv, float mass,
-	float rest_length, float drag_coef, float start_x, float start_y, float z_val) : num_ropes_(num_ropes),
-	pts_per_rope_(num_columns), k_(k), kv_(kv), mass_(mass), rest_length_(rest_length), drag_coef_(drag_coef) {
+	float rest_length, float drag_coef, float start_x, float start_y, float z_val, ForceMode force_mode) : num_ropes_(num_ropes),
+	pts_per_rope_(num_columns), k_(k), kv_(kv), mass_(mass), rest_length_(rest_length), drag_coef_(drag_coef),
+	force_mode_(force_mode), integrator_(Integrator::ImprovedEuler), implicit_ready_(false),
+	xpbd_ready_(false), projective_ready_(false), forces_current_(false), max_substeps_(16),
+	max_point_springs_(0), min_rest_length_(0.0f), sleeping_(false), step_count_(0) {
 	// Create the mesh
 	air_res_ = glm::vec3(0, 0, 0);
 	num_pts_ = num_ropes * pts_per_rope_;
 	cloth_pts_ = new glm::vec3[num_pts_];
-	vels_ = new glm::vec3[num_pts_];
-	accels_ = new glm::vec3[num_pts_];
+	pos_.Resize(num_pts_);
+	vel_.Resize(num_pts_);
+	inv_mass_ = AllocateLane(num_pts_);
 	lock_ = new bool[num_pts_];
 	norms_ = new glm::vec3[num_pts_];
 	tans_ = new glm::vec3[num_pts_];
+	normals_current_ = false;
+	tangents_current_ = false;
 	uvs_ = new glm::vec2[num_pts_];
 	indices_ = new unsigned int[6 * (num_ropes_ - 1) * (pts_per_rope_ - 1)];
 	
@@ -31,8 +45,7 @@ Cloth::Cloth(int num_ropes, int num_columns, float k, float kv, float mass,
 		for (int i = 0; i < pts_per_rope_; i++) {
 			int index = j * pts_per_rope_ + i;
 			cloth_pts_[index] = glm::vec3(start_x + j * rest_length_, start_y, z_val + i * rest_length_);
-			vels_[index] = glm::vec3(0, 0, 0);
-			accels_[index] = glm::vec3(0, 0, 0);
+			inv_mass_[index] = 1.0f / mass_;
 			norms_[index] = glm::vec3(0, 0, -1);
 			tans_[index] = glm::vec3(-1, 0, 0);
 			lock_[index] = false;
@@ -58,336 +71,785 @@ Cloth::Cloth(int num_ropes, int num_columns, float k, float kv, float mass,
 		}
 	}
 	num_tris_ = 2 * (num_ropes_ - 1) * (pts_per_rope_ - 1);
-	calcVertexNormals();
-	calcVertexTangents();
+	pos_.Load(cloth_pts_);
+	SetSimdLevel(DetectSimdLevel());
+	SetTileSize(0);
+	SetThreadCount(1);
+	int segments = (pts_per_rope_ + SleepTracker::kTilePoints - 1) / SleepTracker::kTilePoints;
+	setupChangeBlocks(num_ropes_ * segments, segments);
+}
+
+/**
+ * Copy an arbitrary triangle mesh, for MeshCloth. There are no ropes, so the grid passes must
+ * not be used. Without uvs the points are projected onto the xy plane of their bounding box,
+ * the tangents need some parametrization.
+ */
+Cloth::Cloth(const glm::vec3 *points, const glm::vec2 *uvs, int num_pts, const unsigned int *indices, int num_tris,
+	float k, float kv, float mass, float drag_coef) : pts_per_rope_(0), num_ropes_(0), num_pts_(num_pts),
+	k_(k), kv_(kv), mass_(mass), rest_length_(0.0f), drag_coef_(drag_coef), num_tris_(num_tris),
+	force_mode_(ForceMode::Gather), integrator_(Integrator::ImprovedEuler), implicit_ready_(false),
+	xpbd_ready_(false), projective_ready_(false), forces_current_(false), max_substeps_(16),
+	max_point_springs_(0), min_rest_length_(0.0f), sleeping_(false), step_count_(0) {
+	air_res_ = glm::vec3(0, 0, 0);
+	cloth_pts_ = new glm::vec3[num_pts_];
+	pos_.Resize(num_pts_);
+	vel_.Resize(num_pts_);
+	inv_mass_ = AllocateLane(num_pts_);
+	lock_ = new bool[num_pts_];
+	norms_ = new glm::vec3[num_pts_];
+	tans_ = new glm::vec3[num_pts_];
+	normals_current_ = false;
+	tangents_current_ = false;
+	uvs_ = new glm::vec2[num_pts_];
+	indices_ = new unsigned int[3 * num_tris_];
+
+	glm::vec3 lower = num_pts_ > 0 ? points[0] : glm::vec3(0, 0, 0);
+	glm::vec3 upper = lower;
+	for (int i = 0; i < num_pts_; ++i) {
+		lower = glm::min(lower, points[i]);
+		upper = glm::max(upper, points[i]);
+	}
+	glm::vec3 extent = glm::max(upper - lower, glm::vec3(1e-6f));
+	for (int i = 0; i < num_pts_; ++i) {
+		cloth_pts_[i] = points[i];
+		inv_mass_[i] = 1.0f / mass_;
+		norms_[i] = glm::vec3(0, 0, -1);
+		tans_[i] = glm::vec3(-1, 0, 0);
+		lock_[i] = false;
+		uvs_[i] = uvs ? uvs[i] : glm::vec2((points[i].x - lower.x) / extent.x, (points[i].y - lower.y) / extent.y);
+	}
+	for (int i = 0; i < 3 * num_tris_; ++i) {
+		indices_[i] = indices[i];
+	}
+	pos_.Load(cloth_pts_);
+	SetSimdLevel(DetectSimdLevel());
+	SetTileSize(0);
+	SetThreadCount(1);
+	setupChangeBlocks(1, 0);
 }
 
 Cloth::~Cloth() {
 	delete [] cloth_pts_;
-	delete [] vels_;
-	delete [] accels_;
+	delete [] block_start_;
+	delete [] block_change_step_;
+	delete [] block_moved_;
+	delete [] block_lower_;
+	delete [] block_upper_;
+	FreeLane(inv_mass_);
 	delete [] lock_;
 
 	delete [] norms_;
 	delete [] tans_;
 	delete [] uvs_;
 	delete [] indices_;
-	
-	glDeleteVertexArrays(1, &cloth_vao_);
-	glDeleteBuffers(1, &mesh_buffer_);
-	glDeleteBuffers(1, &index_buffer_);
-	glDeleteTextures(1, &diffuse_map_);
-	glDeleteTextures(1, &normal_map_);
-}
-
-/**
- * Intialize the OpenGL buffers used for cloth rendering. This method assumes the argument shader contains the following
- * variables:
- * vertex input variable
- * normal input variable
- * tangent input variable
- * tex_coord input variable
- * 
- * diffuse_map uniform sampler
- * normal_map uniform sampler
+}
+
+/**
+ * Enable/Disable the cloth point at the specified position. This effectively clamps a
+ * point in place. A locked point has an inverse mass of 0 and no velocity, so the
+ * integrators can move every point without checking the lock flags.
  */ 
-void Cloth::initGL(GLuint shader) {
-    glGenVertexArrays(1, &cloth_vao_);
-    glBindVertexArray(cloth_vao_);
-	
-	glGenBuffers(1, &mesh_buffer_);
-	updateGPU();
-	glBindBuffer(GL_ARRAY_BUFFER, mesh_buffer_);
-	size_t vec3_size = sizeof(glm::vec3);
-	GLsizeiptr pts_size = num_pts_ * vec3_size;
-	GLsizeiptr norm_size = pts_size;
-	GLsizeiptr tans_size = pts_size;
-	GLsizeiptr uv_size = num_pts_ * sizeof(glm::vec2);
-	GLsizeiptr tot_size = pts_size + norm_size + tans_size + uv_size;
-	
-	GLint pos_attrib = glGetAttribLocation(shader, "vertex");
-  	glVertexAttribPointer(pos_attrib, 3, GL_FLOAT, GL_FALSE, vec3_size, nullptr);
-    glEnableVertexAttribArray(pos_attrib);
+void Cloth::LockNode(int x, int y, bool lock) {
+	LockPoint(x * pts_per_rope_ + y, lock);
+}
 
-	GLint norm_attrib = glGetAttribLocation(shader, "normal");
-	glVertexAttribPointer(norm_attrib, 3, GL_FLOAT, GL_FALSE, vec3_size, (void*)pts_size);
-	glEnableVertexAttribArray(norm_attrib);
+/**
+ * Move every point to positions[i], as if a step had ended there: the changed blocks are stamped
+ * and the normals and tangents follow when next read. The velocities are kept and sleeping tiles
+ * are woken. A cloth built like another one mirrors it this way, see AsyncSimulation.
+ */
+void Cloth::SetPositions(const glm::vec3 *positions) {
+	pos_.Load(positions);
+	forces_current_ = false;
+	if (sleeping_) {
+		sleep_.WakeAll();
+	}
+	storePositions();
+}
 
-	GLint tan_attrib = glGetAttribLocation(shader, "tangent");
-	glVertexAttribPointer(tan_attrib, 3, GL_FLOAT, GL_FALSE, vec3_size, (void*)(pts_size + norm_size));
-	glEnableVertexAttribArray(tan_attrib);
+/**
+ * Enable/Disable the cloth point with the given index, like LockNode().
+ */
+void Cloth::LockPoint(int index, bool lock) {
+	lock_[index] = lock;
+	inv_mass_[index] = lock ? 0.0f : 1.0f / mass_;
+	forces_current_ = false;
+	if (lock) {
+		vel_.Lanes().Set(index, glm::vec3(0, 0, 0));
+	}
+	if (sleeping_) {
+		sleep_.Wake(index);
+	}
+}
 
-	GLint uv_attrib = glGetAttribLocation(shader, "tex_coord");
-	glVertexAttribPointer(uv_attrib, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)(pts_size + norm_size + tans_size));
-	glEnableVertexAttribArray(uv_attrib);
+/**
+ * Choose the instruction set used by the spring kernels. The constructor picks the best one the
+ * CPU supports, forcing SimdLevel::Scalar runs the reference kernel for validation.
+ */
+void Cloth::SetSimdLevel(SimdLevel level) {
+	if (level > DetectSimdLevel()) {
+		level = DetectSimdLevel();
+	}
+	simd_level_ = level;
+	spring_kernel_ = SelectSpringKernel(level);
+}
 
-	glGenBuffers(1, &index_buffer_);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, 3 * num_tris_ * sizeof(unsigned int), indices_, GL_STATIC_DRAW);
-	
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+/**
+ * Set the number of threads used to step the simulation, including the calling thread. A count
+ * below 1 uses one thread per hardware thread.
+ */
+void Cloth::SetThreadCount(int num_threads) {
+	if (num_threads < 1) {
+		num_threads = (int)std::thread::hardware_concurrency();
+		num_threads = num_threads < 1 ? 1 : num_threads;
+	}
+	if (!pool_ || pool_->NumThreads() != num_threads) {
+		pool_.reset(new ThreadPool(num_threads));
+	}
+	workspace_.Resize(num_pts_, pts_per_rope_, num_threads);
+}
 
-	// Load textures	
-	loadTexture("fabric_diffuse.jpg", &diffuse_map_);
-	loadTexture("fabric_normal.jpg", &normal_map_);
-	
-	// Set up textures in shader
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, diffuse_map_);
-	
-    glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, normal_map_);
-	
-	glUseProgram(shader);
-	glUniform1i(glGetUniformLocation(shader, "diffuse_map"), 0);
-	glUniform1i(glGetUniformLocation(shader, "normal_map"), 1);
-    glUseProgram(0);
-	
-	glBindVertexArray(0);
+/**
+ * Set the number of points per rope segment in the tiled traversal. Ropes longer than this are
+ * split into segments, and the gather force pass and the normal pass walk each band of segments
+ * across all ropes before moving on, so the neighboring ropes are still in cache when they are
+ * needed again. A size below 1 picks one from the cache sizes, so a band of segments fills
+ * about half of the L2 cache. Only ForceMode::Gather tiles the forces, the normals are tiled
+ * in every mode.
+ */
+void Cloth::SetTileSize(int num_points) {
+	if (num_points < 1) {
+		size_t cache_size = DetectCacheSizes().l2;
+		if (cache_size == 0) {
+			cache_size = 256 * 1024;
+		}
+		num_points = (int)(cache_size / 2 / kTileBytesPerPoint);
+	}
+	// whole blocks of lanes keep the segments aligned
+	num_points = num_points / kLaneWidth * kLaneWidth;
+	tile_size_ = num_points < kLaneWidth ? kLaneWidth : num_points;
 }
 
 /**
- * Enable/Disable the cloth point at the specified position. This effectively clamps a
- * point in place.
- */ 
-void Cloth::LockNode(int x, int y, bool lock) {
-	int index = x * pts_per_rope_ + y;
-	lock_[index] = lock;
+ * Pick the integrator used by Update().
+ */
+void Cloth::SetIntegrator(Integrator integrator) {
+	integrator_ = integrator;
+	forces_current_ = false;
+}
+
+/**
+ * Configure the conjugate gradient solve of Integrator::BackwardEuler, it stops once the
+ * residual is below tolerance relative to the right hand side or after max_iterations.
+ */
+void Cloth::SetSolverTolerance(float tolerance, int max_iterations) {
+	implicit_.SetTolerance(tolerance, max_iterations);
+}
+
+/**
+ * Let settled parts of a grid cloth sleep, see SleepTracker. Sleeping tiles are skipped by the
+ * force and integration passes of the explicit integrators until motion next to them or a lock
+ * change wakes them up. The other integrators, and MeshCloth, always simulate everything.
+ * Enabling it starts with every tile awake.
+ */
+void Cloth::SetSleeping(bool enabled) {
+	sleeping_ = enabled;
+	if (enabled) {
+		sleep_.Setup(num_ropes_, pts_per_rope_);
+	}
+	forces_current_ = false;
+}
+
+/**
+ * Set the largest kinetic energy of a point and the largest net force on a free point that
+ * still let a tile fall asleep.
+ */
+void Cloth::SetSleepThresholds(float kinetic_energy, float force) {
+	sleep_.SetThresholds(kinetic_energy, force);
+}
+
+/**
+ * Set the number of constraint sweeps per step of Integrator::XPBD, and of local/global
+ * iterations of Integrator::ProjectiveDynamics. More iterations make stiff cloth stretch less,
+ * the cost per step grows linearly with them.
+ */
+void Cloth::SetConstraintIterations(int num_iterations) {
+	xpbd_.SetIterations(num_iterations);
+	projective_.SetIterations(num_iterations);
+}
+
+/**
+ * The springs of the grid as an explicit list, for the solvers that are not specialized for
+ * the grid. Each rope's springs along it come first, then the ones to the next rope. The list
+ * is built on first use.
+ */
+const SpringList& Cloth::springList() {
+	if (grid_springs_.Size() == 0 && num_pts_ > 0) {
+		grid_springs_.Resize(num_ropes_ * (pts_per_rope_ - 1) + (num_ropes_ - 1) * pts_per_rope_);
+		int s = 0;
+		for (int j = 0; j < num_ropes_; j++) {
+			int rope_start = j * pts_per_rope_;
+			for (int i = 0; i < pts_per_rope_ - 1; i++) {
+				grid_springs_.Set(s++, rope_start + i, rope_start + i + 1, rest_length_);
+			}
+			if (j < num_ropes_ - 1) {
+				for (int i = 0; i < pts_per_rope_; i++) {
+					grid_springs_.Set(s++, rope_start + i, rope_start + pts_per_rope_ + i, rest_length_);
+				}
+			}
+		}
+	}
+	return grid_springs_;
 }
 
 /**
- * Update the Cloth positions and Velocities using the Improved Euler Method
+ * Update the Cloth positions and Velocities using the Improved Euler Method, or the method
+ * chosen with SetIntegrator()
  */
 void Cloth::Update(float dt) {
-	// calculate the forces at the current timestep
-	glm::vec3 *cur_forces = calcForces();
-	// now integrate half a step into the future
-	for(int i = 0; i < num_pts_; ++i) {
-		if(lock_[i]) {
-			continue;
+	size_t start_allocations = HeapAllocationCount();
+	// the second force evaluation only needs the first one's results during the half step,
+	// so both share the same workspace buffer
+	Vec3Lanes &forces = workspace_.Forces();
+	if (integrator_ == Integrator::BackwardEuler) {
+		calcForces(forces);
+		stepImplicit(forces, dt);
+	} else if (integrator_ == Integrator::XPBD) {
+		calcExternalForces(forces);
+		stepXpbd(forces, dt);
+	} else if (integrator_ == Integrator::ProjectiveDynamics) {
+		calcExternalForces(forces);
+		stepProjective(forces, dt);
+	} else if (integrator_ == Integrator::SymplecticEuler) {
+		calcForces(forces);
+		integrate(forces, dt);
+	} else if (integrator_ == Integrator::PositionVerlet) {
+		kickDrift(nullptr, 0.0f, 0.5f * dt);
+		calcForces(forces);
+		kickDrift(&forces, dt, 0.5f * dt);
+	} else if (integrator_ == Integrator::VelocityVerlet) {
+		// only the first step after a change needs the forces at its start
+		if (!forces_current_) {
+			calcForces(forces);
 		}
-		vels_[i] += cur_forces[i] * 0.5f * dt / mass_;
-		cloth_pts_[i] += vels_[i] * 0.5f * dt;
+		kickDrift(&forces, 0.5f * dt, dt);
+		calcForces(forces);
+		kickDrift(&forces, 0.5f * dt, 0.0f);
+		forces_current_ = true;
+	} else if (force_mode_ == ForceMode::Fused && !sleepActive()) {
+		// same two half steps, each one done in a single pass over the cloth
+		stepFused(forces, 0.5f * dt);
+		stepFused(forces, 0.5f * dt);
+	} else {
+		// calculate the forces at the current timestep
+		calcForces(forces);
+		// now integrate half a step into the future
+		integrate(forces, 0.5f * dt);
+		// now calculate the forces again
+		calcForces(forces);
+		integrate(forces, 0.5f * dt);
 	}
-	// now calculate the forces again
-	glm::vec3 *new_forces = calcForces();
-	for(int i = 0; i < num_pts_; ++i) {
-		if(lock_[i]) {
-			continue;
+
+	if (sleepActive()) {
+		if (sleep_.Update(vel_.Lanes(), forces, inv_mass_, mass_, *pool_)) {
+			// woken tiles have no forces for the next velocity Verlet kick
+			forces_current_ = false;
 		}
-		vels_[i] += new_forces[i] * 0.5f * dt / mass_;
-		cloth_pts_[i] += vels_[i] * 0.5f * dt;
+		stats_.awake_tiles = sleep_.NumAwake();
+		stats_.total_tiles = sleep_.NumTiles();
+	} else {
+		stats_.awake_tiles = stats_.total_tiles = 0;
 	}
-	delete [] cur_forces;
-	delete [] new_forces;
 
-	calcVertexNormals();
-	calcVertexTangents();
-	updateGPU();
+	// the rest of the step works on the render/export layout, the shading attributes wait until
+	// they are read
+	storePositions();
+	stats_.step_allocations = HeapAllocationCount() - start_allocations;
 }
 
 /**
- * Draw the Cloth using OpenGL using the currently bound shader.
- */ 
-void Cloth::Draw() {
-	glBindVertexArray(cloth_vao_);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
-	glDrawElements(GL_TRIANGLES, 3 * num_tris_, GL_UNSIGNED_INT, nullptr);
-	glBindVertexArray(0);
+ * Advance the simulation by frame_dt in as few equal substeps as StableTimestep() allows, but
+ * no more than GetMaxSubsteps(). Stats() reports the substeps taken.
+ */
+void Cloth::Advance(float frame_dt) {
+	float stable_dt = StableTimestep();
+	int substeps = max_substeps_;
+	if (stable_dt > 0.0f && frame_dt / stable_dt < (float)max_substeps_) {
+		substeps = std::max(1, (int)std::ceil(frame_dt / stable_dt));
+	}
+	float substep_dt = frame_dt / substeps;
+	size_t allocations = 0;
+	for (int i = 0; i < substeps; ++i) {
+		Update(substep_dt);
+		allocations += stats_.step_allocations;
+	}
+	stats_.step_allocations = allocations;
+	stats_.substeps = substeps;
+	stats_.substep_dt = substep_dt;
+	stats_.stable_dt = stable_dt;
 }
 
 /**
- * Update the Cloth Model on the GPU for OpenGL drawing. By default, this
- * method is called during Update().
- */ 
-void Cloth::updateGPU() {
-	glBindBuffer(GL_ARRAY_BUFFER, mesh_buffer_);
-	size_t float_size = sizeof(float);
-	size_t vec3_size = sizeof(glm::vec3);
-	GLsizeiptr pts_size = num_pts_ * vec3_size;
-	GLsizeiptr norm_size = num_pts_ * vec3_size;
-	GLsizeiptr tans_size = num_pts_ * vec3_size;
-	GLsizeiptr uv_size = num_pts_ * sizeof(glm::vec2);
-	GLsizeiptr tot_size = pts_size + norm_size + tans_size + uv_size;
-	
-	glBufferData(GL_ARRAY_BUFFER, tot_size, NULL, GL_DYNAMIC_DRAW);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, pts_size, cloth_pts_);
-	glBufferSubData(GL_ARRAY_BUFFER, pts_size, norm_size, norms_);
-	glBufferSubData(GL_ARRAY_BUFFER, pts_size + norm_size, tans_size, tans_);
-	glBufferSubData(GL_ARRAY_BUFFER, pts_size + norm_size + tans_size, uv_size, uvs_);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+ * Estimate the largest timestep that keeps the current integrator stable from here.
+ * The explicit integrators are limited by the stiffest mode of the springs: with at most n
+ * springs at a point the eigenvalues of the stiffness and damping matrices over the mass stay
+ * below w^2 = 2 n k / m and g = 2 n kv / m (Gershgorin), and a damped oscillator stays stable
+ * while h^2 w^2 + 2 h g < 4. Every integrator is also limited by how far a point may move in
+ * one step, half the shortest rest length, whether driven by its current speed or by the
+ * acceleration of the most stretched spring.
+ */
+float Cloth::StableTimestep() {
+	// fraction of the theoretical bounds used, and of the rest length a point may move per step
+	const float kSafety = 0.9f;
+	const float kMaxMotion = 0.5f;
+
+	const SpringList &springs = springList();
+	if (max_point_springs_ == 0 && springs.Size() > 0) {
+		std::vector<int> point_springs(num_pts_, 0);
+		min_rest_length_ = springs.Rest()[0];
+		for (int s = 0; s < springs.Size(); ++s) {
+			max_point_springs_ = std::max(max_point_springs_, ++point_springs[springs.A()[s]]);
+			max_point_springs_ = std::max(max_point_springs_, ++point_springs[springs.B()[s]]);
+			min_rest_length_ = std::min(min_rest_length_, springs.Rest()[s]);
+		}
+	}
+
+	const Vec3Lanes &pos = pos_.Lanes();
+	const Vec3Lanes &vel = vel_.Lanes();
+	for (int t = 0; t < pool_->NumThreads(); ++t) {
+		workspace_.ThreadScalar(t, kMaxSpeedSquared) = 0.0f;
+		workspace_.ThreadScalar(t, kMaxStretch) = 0.0f;
+	}
+	pool_->ParallelFor(0, num_pts_, [&](int first, int last, int thread) {
+		float max_speed_sq = 0.0f;
+		for (int i = first; i < last; ++i) {
+			glm::vec3 v = vel.Get(i);
+			max_speed_sq = std::max(max_speed_sq, glm::dot(v, v));
+		}
+		workspace_.ThreadScalar(thread, kMaxSpeedSquared) = max_speed_sq;
+	});
+	pool_->ParallelFor(0, springs.Size(), [&](int first, int last, int thread) {
+		float max_stretch = 0.0f;
+		for (int s = first; s < last; ++s) {
+			float length = glm::length(pos.Get(springs.A()[s]) - pos.Get(springs.B()[s]));
+			max_stretch = std::max(max_stretch, std::abs(length - springs.Rest()[s]));
+		}
+		workspace_.ThreadScalar(thread, kMaxStretch) = max_stretch;
+	});
+	float max_speed_sq = 0.0f;
+	float max_stretch = 0.0f;
+	for (int t = 0; t < pool_->NumThreads(); ++t) {
+		max_speed_sq = std::max(max_speed_sq, workspace_.ThreadScalar(t, kMaxSpeedSquared));
+		max_stretch = std::max(max_stretch, workspace_.ThreadScalar(t, kMaxStretch));
+	}
+
+	float stable_dt = std::numeric_limits<float>::max();
+	bool is_explicit = integrator_ != Integrator::BackwardEuler && integrator_ != Integrator::XPBD &&
+		integrator_ != Integrator::ProjectiveDynamics;
+	if (is_explicit && max_point_springs_ > 0 && (k_ > 0.0f || kv_ > 0.0f)) {
+		float omega_sq = 2.0f * max_point_springs_ * k_ / mass_;
+		float gamma = 2.0f * max_point_springs_ * kv_ / mass_;
+		stable_dt = kSafety * 4.0f / (gamma + std::sqrt(gamma * gamma + 4.0f * omega_sq));
+	}
+	float max_motion = kMaxMotion * min_rest_length_;
+	if (max_motion > 0.0f) {
+		if (max_speed_sq > 0.0f) {
+			stable_dt = std::min(stable_dt, max_motion / std::sqrt(max_speed_sq));
+		}
+		float max_accel = ((float)max_point_springs_ * k_ * max_stretch + kGravityForce) / mass_;
+		stable_dt = std::min(stable_dt, std::sqrt(2.0f * max_motion / max_accel));
+	}
+	return stable_dt;
 }
 
 /**
- * Calculate the cloth-fiber forces at each cloth point using Hooke's Law and Rayleigh Number.
- */ 
-glm::vec3* Cloth::calcForces() {
-	glm::vec3 *forces = new glm::vec3[num_pts_];
-	for (int i = 0; i < num_pts_; ++i) {
-		forces[i] = glm::vec3(0, -.1, 0);
+ * Advance the velocities and then the positions by h using the given forces. Locked points
+ * have zero inverse mass and zero velocity, so they stay in place.
+ */
+void Cloth::integrate(const Vec3Lanes &forces, float h) {
+	if (sleepActive()) {
+		forEachAwakeRun([&](int first, int last) {
+			integratePoints(forces, first, last, h);
+		});
+		return;
 	}
+	pool_->ParallelFor(0, num_pts_, [&](int first, int last, int) {
+		integratePoints(forces, first, last, h);
+	});
+}
 
-	for (int j = 0; j < num_ropes_; j++) {
-		// calculate all the vertical spring forces
-		for (int i = 0; i < pts_per_rope_ - 1; i++) {
-			int cur_pt = j * pts_per_rope_ + i;
-			int lower_index = cur_pt + 1;
-			glm::vec3 diff = cloth_pts_[cur_pt] - cloth_pts_[lower_index];
-			float string_force = -k_ * (glm::length(diff) - rest_length_);
-
-			// velocity spring force here
-			glm::vec3 string_dir = glm::normalize(diff);
-			double proj_btm_pt = glm::dot(vels_[lower_index], string_dir);
-			double proj_top_pt = glm::dot(vels_[cur_pt], string_dir);
-			float damp_force = -kv_ * (proj_top_pt - proj_btm_pt);
-
-			// combine it all together
-			glm::vec3 force = string_dir * (string_force + damp_force);
-			forces[cur_pt] = forces[cur_pt] + force;
-			forces[lower_index] = forces[lower_index] + force * (-1.0f);
+/**
+ * Convert the positions to the render layout, and stamp the blocks whose points moved, and
+ * their neighbors whose normals and tangents depend on them, with the new step count.
+ */
+void Cloth::storePositions() {
+	++step_count_;
+	normals_current_ = false;
+	tangents_current_ = false;
+	const Vec3Lanes &pos = pos_.Lanes();
+	pool_->ParallelFor(0, num_change_blocks_, [&](int first, int last, int) {
+		for (int b = first; b < last; ++b) {
+			bool moved = false;
+			glm::vec3 lower = pos.Get(block_start_[b]);
+			glm::vec3 upper = lower;
+			for (int i = block_start_[b]; i < block_start_[b + 1]; ++i) {
+				glm::vec3 p = pos.Get(i);
+				moved |= p.x != cloth_pts_[i].x || p.y != cloth_pts_[i].y || p.z != cloth_pts_[i].z;
+				cloth_pts_[i] = p;
+				lower = glm::min(lower, p);
+				upper = glm::max(upper, p);
+			}
+			block_moved_[b] = moved;
+			block_lower_[b] = lower;
+			block_upper_[b] = upper;
+		}
+	});
+	// the normals of a point depend on the points one step along and across the ropes
+	const int neighbors[] = {0, -1, 1, -change_block_stride_, change_block_stride_};
+	for (int b = 0; b < num_change_blocks_; ++b) {
+		if (block_moved_[b]) {
+			for (int offset : neighbors) {
+				int n = b + offset;
+				if (n >= 0 && n < num_change_blocks_) {
+					block_change_step_[n] = step_count_;
+				}
+			}
 		}
 	}
+}
+
+static void writeTangent(RenderVertex &vertex, const glm::vec3 &tangent) {
+	vertex.tangent = tangent;
+}
+
+static void writeTangent(RenderVertexNoTangent&, const glm::vec3&) {
+}
+
+static void writeTangent(CompactVertex &vertex, const glm::vec3 &tangent) {
+	OctahedralEncode(tangent, vertex.tangent);
+}
+
+static void writeTangent(CompactVertexNoTangent&, const glm::vec3&) {
+}
+
+/**
+ * Interleave the positions, normals and tangents of the points [first, last) into vertices,
+ * vertices[0] receives point first. The points are split over the threads, so vertices can be
+ * mapped GPU memory that is written once and never read.
+ */
+void Cloth::WriteVertices(RenderVertex *vertices, int first, int last) const {
+	UpdateShading(true);
+	writeFloatVertices(vertices, first, last);
+}
 
-	for (int j = 0; j < pts_per_rope_; j++) {
-		// calculate all the horizontal spring forces
-		for (int i = 0; i < num_ropes_ - 1; i++) {
-			int cur_pt = j + pts_per_rope_ * i;
-			int right_index = j + (pts_per_rope_ * (i + 1));
-			glm::vec3 diff = cloth_pts_[cur_pt] - cloth_pts_[right_index];
-			float string_force = -k_ * (glm::length(diff) - rest_length_);
-
-			// velocity spring force here
-			glm::vec3 string_dir = glm::normalize(diff);
-			float proj_btm_pt = glm::dot(vels_[right_index], string_dir);
-			float proj_top_pt = glm::dot(vels_[cur_pt], string_dir);
-			float damp_force = -kv_ * (proj_top_pt - proj_btm_pt);
-
-			// combine it all together
-			glm::vec3 force = string_dir * (string_force + damp_force);
-			forces[cur_pt] = forces[cur_pt] + force;
-			forces[right_index] = forces[right_index] + force * (-1.0f);
+/**
+ * Write the points [first, last) without their tangents, which are not computed for it.
+ */
+void Cloth::WriteVertices(RenderVertexNoTangent *vertices, int first, int last) const {
+	UpdateShading(false);
+	writeFloatVertices(vertices, first, last);
+}
+
+template <typename Vertex>
+void Cloth::writeFloatVertices(Vertex *vertices, int first, int last) const {
+	pool_->ParallelFor(first, last, [&](int begin, int end, int) {
+		for (int i = begin; i < end; ++i) {
+			Vertex &vertex = vertices[i - first];
+			vertex.position = cloth_pts_[i];
+			vertex.normal = norms_[i];
+			writeTangent(vertex, tans_[i]);
 		}
-	}
+	});
+}
 
-	// calculate air drag - this means iterating over triangles
-	for (int j = 0; j < num_ropes_ - 1; j++) {
-		for (int i = 0; i < pts_per_rope_ - 1; i++) {
-			int index1 = j * pts_per_rope_ + i;
-			int index2 = j * pts_per_rope_ + i + 1;
-			int index3 = (j + 1) * pts_per_rope_ + i;
-			int index4 = (j + 1) * pts_per_rope_ + i + 1;
+/**
+ * Write the points [first, last) in the compact format, the positions are quantized to 16 bits
+ * inside the box starting at box_lower with the size box_extent, which must contain them.
+ */
+void Cloth::WriteVertices(CompactVertex *vertices, int first, int last, const glm::vec3 &box_lower,
+	const glm::vec3 &box_extent) const {
+	UpdateShading(true);
+	writeCompactVertices(vertices, first, last, box_lower, box_extent);
+}
+
+void Cloth::WriteVertices(CompactVertexNoTangent *vertices, int first, int last, const glm::vec3 &box_lower,
+	const glm::vec3 &box_extent) const {
+	UpdateShading(false);
+	writeCompactVertices(vertices, first, last, box_lower, box_extent);
+}
 
-			// start with one triangle
-			glm::vec3 avg_vel = (vels_[index1] + vels_[index2] + vels_[index3]) / 3.0f - air_res_;
-			glm::vec3 normal = glm::cross(cloth_pts_[index1] - cloth_pts_[index2], cloth_pts_[index3] - cloth_pts_[index2]);
-			float v_a_n = glm::length(avg_vel) * (glm::dot(avg_vel, normal)) * 0.5f;
-			normal = glm::normalize(normal);
-			glm::vec3 res = -0.5f * drag_coef_ * v_a_n * normal;
-			// now divide by 3, then apply to each particle
-			res = res / 3.0f;
-			forces[index1] = forces[index1] + res;
-			forces[index2] = forces[index2] + res;
-			forces[index3] = forces[index3] + res;
-
-			// now do the other triangle
-			avg_vel = (vels_[index2] + vels_[index4] + vels_[index4]) / 3.0f;
-			normal = glm::cross(cloth_pts_[index2] - cloth_pts_[index4], cloth_pts_[index3] - cloth_pts_[index4]);
-			v_a_n = glm::length(avg_vel) * glm::dot(avg_vel, normal) * 0.75f;
-			normal = glm::normalize(normal);
-			res = -0.5f * drag_coef_ * v_a_n * normal;
-			// now divide by 3, then apply to each particle
-			res = res / 3.0f;
-			forces[index2] = forces[index2] + res;
-			forces[index4] = forces[index4] + res;
-			forces[index3] = forces[index3] + res;
+template <typename Vertex>
+void Cloth::writeCompactVertices(Vertex *vertices, int first, int last, const glm::vec3 &box_lower,
+	const glm::vec3 &box_extent) const {
+	glm::vec3 scale(0.0f);
+	for (int c = 0; c < 3; ++c) {
+		if (box_extent[c] > 0.0f) {
+			scale[c] = 65535.0f / box_extent[c];
 		}
 	}
-	
-	return forces;
+	pool_->ParallelFor(first, last, [&](int begin, int end, int) {
+		for (int i = begin; i < end; ++i) {
+			Vertex &vertex = vertices[i - first];
+			glm::vec3 quantized = (cloth_pts_[i] - box_lower) * scale + glm::vec3(0.5f);
+			vertex.position[0] = (uint16_t)ClampQuantized(quantized.x, 0.0f, 65535.0f);
+			vertex.position[1] = (uint16_t)ClampQuantized(quantized.y, 0.0f, 65535.0f);
+			vertex.position[2] = (uint16_t)ClampQuantized(quantized.z, 0.0f, 65535.0f);
+			vertex.position[3] = 0;
+			OctahedralEncode(norms_[i], vertex.normal);
+			writeTangent(vertex, tans_[i]);
+		}
+	});
 }
 
 /**
- * Calculate the normal vector at each cloth point in the cloth model. These are used for illuminating
- * the cloth in OpenGL rendering.
- */ 
-void Cloth::calcVertexNormals() {
-	// reset each normal to 0
-	for(int i = 0; i < num_pts_; ++i) {
-		norms_[i] = glm::vec3(0, 0, 0);
+ * Split the points into num_blocks blocks, stride blocks per rope for a grid cloth.
+ */
+void Cloth::setupChangeBlocks(int num_blocks, int stride) {
+	num_change_blocks_ = num_blocks;
+	change_block_stride_ = stride;
+	block_start_ = new int[num_blocks + 1];
+	block_change_step_ = new unsigned long[num_blocks];
+	block_moved_ = new bool[num_blocks];
+	block_lower_ = new glm::vec3[num_blocks];
+	block_upper_ = new glm::vec3[num_blocks];
+	for (int b = 0; b < num_blocks; ++b) {
+		block_start_[b] = stride == 0 ? 0
+			: (b / stride) * pts_per_rope_ + std::min((b % stride) * SleepTracker::kTilePoints, pts_per_rope_);
+		block_change_step_[b] = 0;
 	}
-	// iterate through each face and accumulate the normals for each vertex
-	for(int i = 0; i < num_tris_; ++i) {
-		int idx1 = indices_[3 * i];
-		int idx2 = indices_[3 * i + 1];
-		int idx3 = indices_[3 * i + 2];
-		glm::vec3 face_normal = glm::cross(cloth_pts_[idx2] - cloth_pts_[idx1], cloth_pts_[idx3] - cloth_pts_[idx1]);
-		norms_[idx1] = norms_[idx1] + face_normal;
-		norms_[idx2] = norms_[idx2] + face_normal;
-		norms_[idx3] = norms_[idx3] + face_normal;
+	block_start_[num_blocks] = num_pts_;
+	calcBlockBounds();
+}
+
+/**
+ * Recompute the bounds of every block from the render layout positions, storePositions() keeps
+ * them up to date during the steps.
+ */
+void Cloth::calcBlockBounds() {
+	for (int b = 0; b < num_change_blocks_; ++b) {
+		glm::vec3 lower = cloth_pts_[block_start_[b]];
+		glm::vec3 upper = lower;
+		for (int i = block_start_[b]; i < block_start_[b + 1]; ++i) {
+			lower = glm::min(lower, cloth_pts_[i]);
+			upper = glm::max(upper, cloth_pts_[i]);
+		}
+		block_lower_[b] = lower;
+		block_upper_[b] = upper;
 	}
+}
 
-	for(int i = 0; i < num_pts_; ++i) {
-		norms_[i] = glm::normalize(norms_[i]);
+void Cloth::Bounds(glm::vec3 *lower, glm::vec3 *upper) const {
+	*lower = block_lower_[0];
+	*upper = block_upper_[0];
+	for (int b = 1; b < num_change_blocks_; ++b) {
+		*lower = glm::min(*lower, block_lower_[b]);
+		*upper = glm::max(*upper, block_upper_[b]);
 	}
 }
 
-void Cloth::calcVertexTangents() {
-	for (int i = 0; i < num_pts_; ++i) {
-		tans_[i] = glm::vec3(0, 0, 0);
+/**
+ * Stamp every block as changed, for changes made outside of a step.
+ */
+void Cloth::markAllChanged() {
+	++step_count_;
+	normals_current_ = false;
+	tangents_current_ = false;
+	calcBlockBounds();
+	std::fill(block_change_step_, block_change_step_ + num_change_blocks_, step_count_);
+}
+
+/**
+ * Whether this step skips the sleeping tiles, only the grid passes of the explicit integrators
+ * know about tiles.
+ */
+bool Cloth::sleepActive() const {
+	return sleeping_ && num_ropes_ > 0 && integrator_ != Integrator::BackwardEuler &&
+		integrator_ != Integrator::XPBD && integrator_ != Integrator::ProjectiveDynamics;
+}
+
+/**
+ * Call fn(first, last) in parallel for every run of points [first, last) of an awake tile.
+ */
+template <typename Fn>
+void Cloth::forEachAwakeRun(const Fn &fn) {
+	pool_->ParallelFor(0, sleep_.NumAwake(), [&](int first, int last, int) {
+		for (int a = first; a < last; ++a) {
+			int tile = sleep_.AwakeTile(a);
+			int rope_first, rope_last, point_first, point_last;
+			sleep_.TileRopes(tile, &rope_first, &rope_last);
+			sleep_.TilePoints(tile, &point_first, &point_last);
+			for (int j = rope_first; j < rope_last; ++j) {
+				fn(j * pts_per_rope_ + point_first, j * pts_per_rope_ + point_last);
+			}
+		}
+	});
+}
+
+/**
+ * Advance the velocities by kick using forces, when given, then the positions by drift. Does
+ * one pass over the points where integrate() would take two.
+ */
+void Cloth::kickDrift(const Vec3Lanes *forces, float kick, float drift) {
+	Vec3Lanes &pos = pos_.Lanes();
+	Vec3Lanes &vel = vel_.Lanes();
+	const float *inv_mass = inv_mass_;
+	auto advance = [&](int first, int last) {
+		if (forces) {
+			for (int i = first; i < last; ++i) {
+				float scale = kick * inv_mass[i];
+				vel.x[i] += forces->x[i] * scale;
+				vel.y[i] += forces->y[i] * scale;
+				vel.z[i] += forces->z[i] * scale;
+			}
+		}
+		if (drift != 0.0f) {
+			for (int i = first; i < last; ++i) {
+				pos.x[i] += vel.x[i] * drift;
+				pos.y[i] += vel.y[i] * drift;
+				pos.z[i] += vel.z[i] * drift;
+			}
+		}
+	};
+	if (sleepActive()) {
+		forEachAwakeRun(advance);
+		return;
 	}
+	pool_->ParallelFor(0, num_pts_, [&](int first, int last, int) {
+		advance(first, last);
+	});
+}
 
-	for (int i = 0; i < num_tris_; ++i) {
-		int idx1 = indices_[3 * i];
-		int idx2 = indices_[3 * i + 1];
-		int idx3 = indices_[3 * i + 2];
+/**
+ * Take a backward Euler step of length h, forces holds the forces at the start of the step.
+ */
+void Cloth::stepImplicit(Vec3Lanes &forces, float h) {
+	if (!implicit_ready_) {
+		implicit_.Setup(num_pts_, springList());
+		implicit_ready_ = true;
+	}
+	Vec3Lanes &pos = pos_.Lanes();
+	Vec3Lanes &vel = vel_.Lanes();
+	stats_.solver_iterations = implicit_.Solve(pos, vel, forces, inv_mass_, mass_, k_, kv_, h, *pool_);
+	stats_.solver_residual = implicit_.Residual();
+
+	const Vec3Lanes &dv = implicit_.DeltaV();
+	pool_->ParallelFor(0, num_pts_, [&](int first, int last, int) {
+		for (int i = first; i < last; ++i) {
+			vel.x[i] += dv.x[i];
+			vel.y[i] += dv.y[i];
+			vel.z[i] += dv.z[i];
+			pos.x[i] += vel.x[i] * h;
+			pos.y[i] += vel.y[i] * h;
+			pos.z[i] += vel.z[i] * h;
+		}
+	});
+}
 
-		glm::vec3 edge1 = cloth_pts_[idx3] - cloth_pts_[idx1];
-		glm::vec3 edge2 = cloth_pts_[idx2] - cloth_pts_[idx1];
-		glm::vec2 uv1 = uvs_[idx3] - uvs_[idx1];
-		glm::vec2 uv2 = uvs_[idx2] - uvs_[idx1];
-		glm::vec3 tangent;
-		float f = 1.0f / (uv1.x * uv2.y - uv2.x * uv1.y);
+/**
+ * Take an XPBD step of length h, forces holds the external forces at the start of the step.
+ */
+void Cloth::stepXpbd(Vec3Lanes &forces, float h) {
+	if (!xpbd_ready_) {
+		xpbd_.Setup(num_pts_, springList());
+		xpbd_ready_ = true;
+	}
+	xpbd_.Step(pos_.Lanes(), vel_.Lanes(), forces, inv_mass_, k_, kv_, h, *pool_);
+	stats_.solver_iterations = xpbd_.GetIterations();
+	stats_.solver_residual = 0.0f;
+}
 
-		tangent.x = f * (uv2.y * edge1.x - uv1.y * edge2.x);
-		tangent.y = f * (uv2.y * edge1.y - uv1.y * edge2.y);
-		tangent.z = f * (uv2.y * edge1.z - uv1.y * edge2.z);
-		
-		tans_[idx1] = tans_[idx1] + tangent;
-		tans_[idx2] = tans_[idx2] + tangent;
-		tans_[idx3] = tans_[idx3] + tangent;
+/**
+ * Take a Projective Dynamics step of length h, forces holds the external forces at the start of
+ * the step. The first step, and the first after a lock or parameter change, factors the matrix.
+ * Parameters that leave the matrix without a factorization, a k + kv / h of 0 or less, fall back
+ * to a symplectic Euler step, reported with 0 solver iterations.
+ */
+void Cloth::stepProjective(Vec3Lanes &forces, float h) {
+	if (!projective_ready_) {
+		projective_.Setup(num_pts_, springList());
+		projective_ready_ = true;
 	}
+	stats_.solver_residual = 0.0f;
+	if (projective_.Step(pos_.Lanes(), vel_.Lanes(), forces, inv_mass_, mass_, k_, kv_, h, *pool_)) {
+		stats_.solver_iterations = projective_.GetIterations();
+		return;
+	}
+	stats_.solver_iterations = 0;
+	calcForces(forces);
+	integrate(forces, h);
+}
 
+/**
+ * Total energy of the free points, in double precision so small drifts show up.
+ */
+double Cloth::Energy() {
+	const Vec3Lanes &pos = pos_.Lanes();
+	const Vec3Lanes &vel = vel_.Lanes();
+	double energy = 0.0;
 	for (int i = 0; i < num_pts_; ++i) {
-		tans_[i] = glm::normalize(tans_[i]);
+		if (inv_mass_[i] == 0.0f) {
+			continue;
+		}
+		glm::vec3 v = vel.Get(i);
+		energy += 0.5 * mass_ * glm::dot(v, v) + kGravityForce * pos.y[i];
+	}
+	const SpringList &springs = springList();
+	for (int s = 0; s < springs.Size(); ++s) {
+		double stretch = glm::length(pos.Get(springs.A()[s]) - pos.Get(springs.B()[s])) - springs.Rest()[s];
+		energy += 0.5 * k_ * stretch * stretch;
+	}
+	return energy;
+}
+
+/**
+ * Integrate the points [first, last) only.
+ */
+void Cloth::integratePoints(const Vec3Lanes &forces, int first, int last, float h) {
+	Vec3Lanes &pos = pos_.Lanes();
+	Vec3Lanes &vel = vel_.Lanes();
+	const float *inv_mass = inv_mass_;
+	for (int i = first; i < last; ++i) {
+		float scale = h * inv_mass[i];
+		vel.x[i] += forces.x[i] * scale;
+		vel.y[i] += forces.y[i] * scale;
+		vel.z[i] += forces.z[i] * scale;
+		pos.x[i] += vel.x[i] * h;
+		pos.y[i] += vel.y[i] * h;
+		pos.z[i] += vel.z[i] * h;
 	}
 }
 
 /**
- * Load a texture to use as the cloth material. This texture is displayed during OpenGL rendering.
+ * Bring the normals and tangents up to date with the positions. Update() only marks them stale,
+ * the pass runs the first time they are read, so the substeps of a frame or a headless run
+ * that never reads them pay nothing for it. Without tangents only the normals are brought up to
+ * date, for consumers that do not read the tangents. Not safe to call concurrently with itself.
+ */
+void Cloth::UpdateShading(bool tangents) const {
+	if (!normals_current_ || (tangents && !tangents_current_)) {
+		calcShading(tangents);
+		normals_current_ = true;
+		tangents_current_ = tangents;
+	}
+}
+
+/**
+ * Calculate the normal and the tangent at each cloth point, used for illuminating the cloth in
+ * OpenGL rendering. One pass gathers both from the triangles around every point, segment by
+ * segment like the tiled force passes (see SetTileSize()), with the ropes split among the threads.
+ * The tangents are only computed when asked for.
  */ 
-void Cloth::loadTexture(std::string file_name, GLuint *texture) {
-	int width, height, num_components;
-	// try both the debug and install directories to find the file
-    // start with debug
-    std::string full_file_path = DEBUG_DIR + std::string("/") + file_name;
-	std::ifstream img_file(full_file_path);
-    if(!img_file.good()) {
-		full_file_path = INSTALL_DIR + std::string("/") + file_name;
-        img_file.open(full_file_path);
-        if(!img_file.good()) {
-            exit(1);
-        }
-    };
-	img_file.close();
-    unsigned char* img_data = stbi_load(full_file_path.c_str(), &width, &height, &num_components, 0);
-    glGenTextures(1, texture);
-    glBindTexture(GL_TEXTURE_2D, *texture);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    GLuint img_type = (num_components == 4) ? GL_RGBA : GL_RGB;
-	glTexImage2D(GL_TEXTURE_2D, 0, img_type, width, height, 0, img_type, GL_UNSIGNED_BYTE, img_data);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    stbi_image_free(img_data);
+void Cloth::calcShading(bool tangents) const {
+	pool_->ParallelFor(0, num_ropes_, [&](int first, int last, int) {
+		for (int seg_first = 0; seg_first < pts_per_rope_; seg_first += tile_size_) {
+			int seg_end = std::min(seg_first + tile_size_, pts_per_rope_);
+			for (int j = first; j < last; j++) {
+				if (tangents) {
+					gridShadingRun<true>(cloth_pts_, norms_, tans_, j, num_ropes_, pts_per_rope_, seg_first, seg_end);
+				} else {
+					gridShadingRun<false>(cloth_pts_, norms_, tans_, j, num_ropes_, pts_per_rope_, seg_first, seg_end);
+				}
+			}
+		}
+	});
 }
\ No newline at end of file
@@ -0,0 +1,210 @@
+#include "cloth.h"
+
+#include <algorithm>
+
+#include "force_kernels.h"
+
+ForceParams Cloth::forceParams() const {
+	ForceParams params;
+	params.k = k_;
+	params.kv = kv_;
+	params.rest_length = rest_length_;
+	params.drag_coef = drag_coef_;
+	params.air_res = air_res_;
+	return params;
+}
+
+GatherScratch Cloth::gatherScratch(int thread) {
+	GatherScratch scratch;
+	scratch.vertical = workspace_.RunScratch(thread, kVerticalSprings);
+	scratch.prev_springs = workspace_.RunScratch(thread, kPrevSprings);
+	scratch.next_springs = workspace_.RunScratch(thread, kNextSprings);
+	scratch.prev_drag_first = workspace_.RunScratch(thread, kPrevDragFirst);
+	scratch.prev_drag_second = workspace_.RunScratch(thread, kPrevDragSecond);
+	scratch.next_drag_first = workspace_.RunScratch(thread, kNextDragFirst);
+	scratch.next_drag_second = workspace_.RunScratch(thread, kNextDragSecond);
+	return scratch;
+}
+
+/**
+ * Calculate the cloth-fiber forces at each cloth point using Hooke's Law and Rayleigh Number.
+ * The result overwrites the num_pts_ entries of forces.
+ */ 
+void Cloth::calcForces(Vec3Lanes &forces) {
+	if (sleepActive()) {
+		calcForcesAwake(forces);
+	} else if (force_mode_ == ForceMode::Scatter) {
+		calcForcesScatter(forces);
+	} else {
+		calcForcesGather(forces);
+	}
+}
+
+/**
+ * Overwrite forces with the forces that do not come from the springs, gravity and air drag.
+ * The constraint based integrators handle the springs themselves.
+ */
+void Cloth::calcExternalForces(Vec3Lanes &forces) {
+	const Vec3Lanes &pos = pos_.Lanes();
+	const Vec3Lanes &vel = vel_.Lanes();
+	const ForceParams params = forceParams();
+	pool_->ParallelFor(0, num_ropes_, [&](int first, int last, int thread) {
+		GatherScratch scratch = gatherScratch(thread);
+		for (int j = first; j < last; j++) {
+			gatherRopeDrag(pos, vel, forces, j, num_ropes_, pts_per_rope_, pts_per_rope_ - 1, j != first, params,
+				scratch);
+			scratch.Advance();
+		}
+	});
+}
+
+/**
+ * Evaluate every spring and drag triangle once and add the result to all of its points.
+ */ 
+void Cloth::calcForcesScatter(Vec3Lanes &forces) {
+	const Vec3Lanes &pos = pos_.Lanes();
+	const Vec3Lanes &vel = vel_.Lanes();
+	const ForceParams params = forceParams();
+	int pts_per_rope = pts_per_rope_;
+
+	// every spring adds its force to both of its end points, so the loops are split into
+	// passes whose ropes never share a point, each pass is then safe to run in parallel
+
+	// the vertical springs of a rope only touch that rope
+	pool_->ParallelFor(0, num_ropes_, [&](int first, int last, int thread) {
+		Vec3Lanes &spring = workspace_.RunScratch(thread, kVerticalSprings);
+		initForces(forces, first * pts_per_rope, (last - first) * pts_per_rope);
+		for (int j = first; j < last; j++) {
+			// calculate all the vertical spring forces, point i is tied to point i + 1
+			int rope_start = j * pts_per_rope;
+			spring_kernel_(makeSpringRun(pos, vel, rope_start, rope_start + 1, pts_per_rope - 1, params, spring));
+			accumulateSpringRun(forces, spring, rope_start, rope_start + 1, pts_per_rope - 1);
+		}
+	});
+
+	// the horizontal springs and drag triangles between ropes i and i + 1 touch both ropes,
+	// so the even and the odd pairs of ropes are processed in separate passes
+	int num_pairs = num_ropes_ - 1;
+	for (int color = 0; color < 2; ++color) {
+		int num_colored = (num_pairs - color + 1) / 2;
+		pool_->ParallelFor(0, num_colored, [&](int first, int last, int thread) {
+			Vec3Lanes &spring = workspace_.RunScratch(thread, kNextSprings);
+			Vec3Lanes &drag_first = workspace_.RunScratch(thread, kNextDragFirst);
+			Vec3Lanes &drag_second = workspace_.RunScratch(thread, kNextDragSecond);
+			for (int c = first; c < last; c++) {
+				int rope_start = (2 * c + color) * pts_per_rope;
+				int next_start = rope_start + pts_per_rope;
+				// calculate all the horizontal spring forces, every point of rope i is tied to
+				// the same point of rope i + 1
+				spring_kernel_(makeSpringRun(pos, vel, rope_start, next_start, pts_per_rope, params, spring));
+				accumulateSpringRun(forces, spring, rope_start, next_start, pts_per_rope);
+
+				// calculate air drag - this means iterating over the triangles between the ropes
+				calcDragRun(pos, vel, rope_start, next_start, pts_per_rope - 1, params, drag_first, drag_second);
+				accumulateDragRun(forces, drag_first, drag_second, rope_start, next_start, pts_per_rope - 1);
+			}
+		});
+	}
+}
+
+/**
+ * Calculate the forces rope by rope, every point gathers the forces of its own springs and drag
+ * triangles. Springs and triangles between two ropes are evaluated for both of them (once per
+ * chunk boundary when consecutive ropes run on the same thread), in exchange no two threads ever
+ * write to the same point and every rope is a single independent task.
+ */
+void Cloth::calcForcesGather(Vec3Lanes &forces) {
+	const ForceParams params = forceParams();
+	if (tile_size_ < pts_per_rope_) {
+		calcForcesTiled(forces, params);
+		return;
+	}
+	pool_->ParallelFor(0, num_ropes_, [&](int first, int last, int thread) {
+		GatherScratch scratch = gatherScratch(thread);
+		for (int j = first; j < last; j++) {
+			calcRopeForces(forces, j, j != first, params, scratch);
+			scratch.Advance();
+		}
+	});
+}
+
+/**
+ * Gather the forces segment by segment, see SetTileSize(). The strip shared with the previous
+ * rope is reused within a band of segments just like whole ropes are reused above.
+ */
+void Cloth::calcForcesTiled(Vec3Lanes &forces, const ForceParams &params) {
+	const Vec3Lanes &pos = pos_.Lanes();
+	const Vec3Lanes &vel = vel_.Lanes();
+	pool_->ParallelFor(0, num_ropes_, [&](int first, int last, int thread) {
+		GatherScratch scratch = gatherScratch(thread);
+		for (int seg_first = 0; seg_first < pts_per_rope_; seg_first += tile_size_) {
+			int seg_end = std::min(seg_first + tile_size_, pts_per_rope_);
+			for (int j = first; j < last; j++) {
+				gatherSegmentForces(pos, vel, forces, j, num_ropes_, pts_per_rope_, seg_first, seg_end, j != first,
+					params, scratch, spring_kernel_);
+				scratch.Advance();
+			}
+		}
+	});
+}
+
+/**
+ * Gather the forces of the awake tiles only, see SetSleeping(). Every tile is a band of rope
+ * segments gathered like in calcForcesTiled(), the sleeping tiles keep their old forces.
+ */
+void Cloth::calcForcesAwake(Vec3Lanes &forces) {
+	const Vec3Lanes &pos = pos_.Lanes();
+	const Vec3Lanes &vel = vel_.Lanes();
+	const ForceParams params = forceParams();
+	pool_->ParallelFor(0, sleep_.NumAwake(), [&](int first, int last, int thread) {
+		GatherScratch scratch = gatherScratch(thread);
+		for (int a = first; a < last; ++a) {
+			int tile = sleep_.AwakeTile(a);
+			int rope_first, rope_last, seg_first, seg_end;
+			sleep_.TileRopes(tile, &rope_first, &rope_last);
+			sleep_.TilePoints(tile, &seg_first, &seg_end);
+			for (int j = rope_first; j < rope_last; j++) {
+				gatherSegmentForces(pos, vel, forces, j, num_ropes_, pts_per_rope_, seg_first, seg_end,
+					j != rope_first, params, scratch, spring_kernel_);
+				scratch.Advance();
+			}
+		}
+	});
+}
+
+/**
+ * Overwrite the forces of rope j, see gatherRopeForces().
+ */
+void Cloth::calcRopeForces(Vec3Lanes &forces, int j, bool reuse_prev, const ForceParams &params,
+	GatherScratch &scratch) {
+	gatherRopeForces(pos_.Lanes(), vel_.Lanes(), forces, j, num_ropes_, pts_per_rope_, pts_per_rope_ - 1,
+		reuse_prev, params, scratch, spring_kernel_);
+}
+
+/**
+ * Advance the cloth by h with the forces gathered rope by rope. The forces of rope j depend on
+ * the old state of ropes j - 1 to j + 1, so rope j - 1 is integrated right after the forces of
+ * rope j, while its points are still in cache. The first and the last rope of each chunk are
+ * also read by the neighboring chunks, they keep their old state until every chunk is done and
+ * are integrated by a second, short pass over the same chunks.
+ */
+void Cloth::stepFused(Vec3Lanes &forces, float h) {
+	const ForceParams params = forceParams();
+	pool_->ParallelFor(0, num_ropes_, [&](int first, int last, int thread) {
+		GatherScratch scratch = gatherScratch(thread);
+		for (int j = first; j < last; j++) {
+			calcRopeForces(forces, j, j != first, params, scratch);
+			scratch.Advance();
+			if (j - 1 > first) {
+				integratePoints(forces, (j - 1) * pts_per_rope_, j * pts_per_rope_, h);
+			}
+		}
+	});
+	// the pool splits the range the same way every time, so these are the chunks from above
+	pool_->ParallelFor(0, num_ropes_, [&](int first, int last, int) {
+		integratePoints(forces, first * pts_per_rope_, (first + 1) * pts_per_rope_, h);
+		if (last - 1 > first) {
+			integratePoints(forces, (last - 1) * pts_per_rope_, last * pts_per_rope_, h);
+		}
+	});
+}
\ No newline at end of file
@@ -0,0 +1,395 @@
+#include "cloth_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "config.h"
+
+ClothRenderer::ClothRenderer(const Cloth &cloth) : cloth_(cloth), cloth_vao_(0), static_buffer_(0),
+	dynamic_buffer_(0), index_buffer_(0), diffuse_map_(0), normal_map_(0), position_texture_(0), format_(VertexFormat::Float),
+	vertex_size_(sizeof(RenderVertex)), pos_attrib_(-1), norm_attrib_(-1), tan_attrib_(-1), uv_attrib_(-1),
+	box_lower_uniform_(-1), box_extent_uniform_(-1), persistent_mapping_(true), num_segments_(1), segment_size_(0), segment_(0),
+	last_upload_bytes_(0), ring_(nullptr), staging_(nullptr) {
+	for (int s = 0; s < kRingSegments; ++s) {
+		segment_step_[s] = 0;
+		fences_[s] = 0;
+		box_fitted_[s] = false;
+		box_lower_[s] = glm::vec3(0.0f);
+		box_extent_[s] = glm::vec3(0.0f);
+	}
+}
+
+ClothRenderer::~ClothRenderer() {
+	delete [] staging_;
+	for (int s = 0; s < kRingSegments; ++s) {
+		glDeleteSync(fences_[s]);
+	}
+	// deleting the dynamic buffer also unmaps the ring
+	glDeleteVertexArrays(1, &cloth_vao_);
+	glDeleteBuffers(1, &static_buffer_);
+	glDeleteBuffers(1, &dynamic_buffer_);
+	glDeleteBuffers(1, &index_buffer_);
+	glDeleteTextures(1, &diffuse_map_);
+	glDeleteTextures(1, &normal_map_);
+	glDeleteTextures(1, &position_texture_);
+}
+
+bool ClothRenderer::SupportsFormat(VertexFormat format, const Cloth &cloth) {
+	if (format == VertexFormat::Positions) {
+		return cloth.NumRopes() > 0 && GLAD_GL_ARB_texture_buffer_object_rgb32;
+	}
+	return true;
+}
+
+/**
+ * Intialize the OpenGL buffers used for cloth rendering. This method assumes the argument shader contains the following
+ * variables:
+ * vertex input variable
+ * normal input variable
+ * tangent input variable
+ * tex_coord input variable
+ * 
+ * diffuse_map uniform sampler
+ * normal_map uniform sampler
+ * position_lower and position_extent uniform vec3, in the compact vertex format only
+ * positions uniform samplerBuffer, num_ropes and points_per_rope uniform int, in the positions
+ * format only, which has no vertex, normal or tangent inputs
+ *
+ * The tangent and tex_coord inputs may be missing or unused, the linker drops inputs that do
+ * not contribute to the output, and the renderer then leaves them out.
+ */ 
+void ClothRenderer::initGL(GLuint shader) {
+	glGenVertexArrays(1, &cloth_vao_);
+	glBindVertexArray(cloth_vao_);
+
+	pos_attrib_ = glGetAttribLocation(shader, "vertex");
+	norm_attrib_ = glGetAttribLocation(shader, "normal");
+	tan_attrib_ = glGetAttribLocation(shader, "tangent");
+	uv_attrib_ = glGetAttribLocation(shader, "tex_coord");
+	box_lower_uniform_ = glGetUniformLocation(shader, "position_lower");
+	box_extent_uniform_ = glGetUniformLocation(shader, "position_extent");
+
+	initStaticStream();
+
+	// dynamic stream, allocated once and then rewritten where the cloth changed
+	int num_pts = cloth_.NumPoints();
+	bool positions = format_ == VertexFormat::Positions;
+	if (positions) {
+		vertex_size_ = sizeof(glm::vec3);
+	} else if (format_ == VertexFormat::Compact) {
+		vertex_size_ = UsesTangents() ? sizeof(CompactVertex) : sizeof(CompactVertexNoTangent);
+	} else {
+		vertex_size_ = UsesTangents() ? sizeof(RenderVertex) : sizeof(RenderVertexNoTangent);
+	}
+	segment_size_ = num_pts * vertex_size_;
+	glGenBuffers(1, &dynamic_buffer_);
+	glBindBuffer(GL_ARRAY_BUFFER, dynamic_buffer_);
+	// the buffer texture of a segment of the ring must start at a multiple of the offset alignment
+	if (persistent_mapping_ && GLAD_GL_ARB_buffer_storage && (!positions || GLAD_GL_ARB_texture_buffer_range)) {
+		if (positions) {
+			GLint alignment = 1;
+			glGetIntegerv(GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+			segment_size_ = (segment_size_ + alignment - 1) / alignment * alignment;
+		}
+		num_segments_ = kRingSegments;
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		GLsizeiptr ring_size = num_segments_ * segment_size_;
+		glBufferStorage(GL_ARRAY_BUFFER, ring_size, NULL, flags);
+		ring_ = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, ring_size, flags);
+	}
+	if (!ring_) {
+		num_segments_ = 1;
+		segment_size_ = num_pts * vertex_size_;
+		staging_ = new char[segment_size_];
+		glBufferData(GL_ARRAY_BUFFER, segment_size_, NULL, GL_DYNAMIC_DRAW);
+	}
+	if (positions) {
+		glGenTextures(1, &position_texture_);
+	}
+	for (int s = 0; s < num_segments_; ++s) {
+		box_fitted_[s] = false;
+		fitQuantizationBox(s);
+		writeBlocks(s, 0, cloth_.NumChangeBlocks());
+		segment_step_[s] = cloth_.StepCount();
+	}
+	segment_ = 0;
+
+	bindDynamicStream(segment_);
+	if (!positions) {
+		glEnableVertexAttribArray(pos_attrib_);
+		glEnableVertexAttribArray(norm_attrib_);
+	}
+	if (UsesTangents()) {
+		glEnableVertexAttribArray(tan_attrib_);
+	}
+
+	glGenBuffers(1, &index_buffer_);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, 3 * cloth_.NumTriangles() * sizeof(unsigned int), cloth_.Indices(), GL_STATIC_DRAW);
+	
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// Load textures	
+	loadTexture("fabric_diffuse.jpg", &diffuse_map_);
+	loadTexture("fabric_normal.jpg", &normal_map_);
+	
+	// Set up textures in shader
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, diffuse_map_);
+	
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, normal_map_);
+	
+	glUseProgram(shader);
+	glUniform1i(glGetUniformLocation(shader, "diffuse_map"), 0);
+	glUniform1i(glGetUniformLocation(shader, "normal_map"), 1);
+	if (positions) {
+		glUniform1i(glGetUniformLocation(shader, "positions"), kPositionTextureUnit);
+		glUniform1i(glGetUniformLocation(shader, "num_ropes"), cloth_.NumRopes());
+		glUniform1i(glGetUniformLocation(shader, "points_per_rope"), cloth_.PointsPerRope());
+	}
+	glUseProgram(0);
+	
+	glBindVertexArray(0);
+}
+
+/**
+ * Copy the cloth's positions, normals, and tangents that changed since the last upload to the
+ * GPU. Call this once after Cloth::Update() for every frame that should display the new state.
+ * Runs of changed blocks are written as one range each, a settled cloth writes nothing. With the
+ * ring the next segment is brought up to date, it may be a few steps behind the cloth.
+ */ 
+void ClothRenderer::Update() {
+	glBindBuffer(GL_ARRAY_BUFFER, dynamic_buffer_);
+	last_upload_bytes_ = 0;
+	int segment = (segment_ + 1) % num_segments_;
+	waitForSegment(segment);
+	unsigned long written_step = segment_step_[segment];
+	int num_blocks = cloth_.NumChangeBlocks();
+	if (fitQuantizationBox(segment)) {
+		// every quantized position of the copy refers to the old box
+		writeBlocks(segment, 0, num_blocks);
+		num_blocks = 0;
+	}
+	for (int b = 0; b < num_blocks;) {
+		if (cloth_.BlockChangeStep(b) <= written_step) {
+			++b;
+			continue;
+		}
+		int first = b;
+		while (b < num_blocks && cloth_.BlockChangeStep(b) > written_step) {
+			++b;
+		}
+		writeBlocks(segment, first, b);
+	}
+	segment_step_[segment] = cloth_.StepCount();
+	if (segment != segment_) {
+		segment_ = segment;
+		glBindVertexArray(cloth_vao_);
+		bindDynamicStream(segment_);
+		glBindVertexArray(0);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * Upload the UVs to the static stream and point the tex_coord attribute of the bound vertex
+ * array at them, unless the shader does not read them. The compact format stores them as 16 bit
+ * unsigned normalized values when they all lie in [0, 1], which holds for every cloth built from
+ * a grid, and as halfs otherwise.
+ */
+void ClothRenderer::initStaticStream() {
+	if (!UsesTexCoords()) {
+		return;
+	}
+	int num_pts = cloth_.NumPoints();
+	const glm::vec2 *uvs = cloth_.UVs();
+	glGenBuffers(1, &static_buffer_);
+	glBindBuffer(GL_ARRAY_BUFFER, static_buffer_);
+	if (format_ == VertexFormat::Float) {
+		glBufferData(GL_ARRAY_BUFFER, num_pts * sizeof(glm::vec2), uvs, GL_STATIC_DRAW);
+		glVertexAttribPointer(uv_attrib_, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), nullptr);
+	} else {
+		bool unit = true;
+		for (int i = 0; i < num_pts; ++i) {
+			unit = unit && uvs[i].x >= 0.0f && uvs[i].x <= 1.0f && uvs[i].y >= 0.0f && uvs[i].y <= 1.0f;
+		}
+		std::vector<uint16_t> packed(2 * num_pts);
+		for (int i = 0; i < num_pts; ++i) {
+			for (int c = 0; c < 2; ++c) {
+				packed[2 * i + c] = unit ? (uint16_t)std::lround(uvs[i][c] * 65535.0f) : FloatToHalf(uvs[i][c]);
+			}
+		}
+		glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(uint16_t), packed.data(), GL_STATIC_DRAW);
+		glVertexAttribPointer(uv_attrib_, 2, unit ? GL_UNSIGNED_SHORT : GL_HALF_FLOAT, unit ? GL_TRUE : GL_FALSE,
+			2 * sizeof(uint16_t), nullptr);
+	}
+	glEnableVertexAttribArray(uv_attrib_);
+}
+
+/**
+ * Make sure the quantization box of a segment holds the cloth, returns true when it had to be
+ * moved. The box gets a margin of a sixteenth of the cloth's size on every side and is only
+ * refit when the cloth leaves it or becomes less than half its size, so a cloth that moves a
+ * little keeps its box and only its changed blocks are rewritten.
+ */
+bool ClothRenderer::fitQuantizationBox(int segment) {
+	if (format_ != VertexFormat::Compact) {
+		return false;
+	}
+	glm::vec3 lower, upper;
+	cloth_.Bounds(&lower, &upper);
+	glm::vec3 size = upper - lower;
+	float max_size = std::max(size.x, std::max(size.y, size.z));
+	float max_extent = std::max(box_extent_[segment].x, std::max(box_extent_[segment].y, box_extent_[segment].z));
+	glm::vec3 box_upper = box_lower_[segment] + box_extent_[segment];
+	bool inside = true;
+	for (int c = 0; c < 3; ++c) {
+		inside = inside && lower[c] >= box_lower_[segment][c] && upper[c] <= box_upper[c];
+	}
+	if (box_fitted_[segment] && inside && max_extent <= 2.0f * max_size) {
+		return false;
+	}
+	float margin = max_size > 0.0f ? max_size / 16.0f : 1.0f;
+	box_lower_[segment] = lower - glm::vec3(margin);
+	box_extent_[segment] = size + glm::vec3(2.0f * margin);
+	box_fitted_[segment] = true;
+	return true;
+}
+
+/**
+ * Point the position, normal and tangent attributes of the bound vertex array at a segment of
+ * the bound dynamic buffer. The vertices without tangents share the layout of the position and
+ * normal of their full counterparts. In the positions format the buffer texture is pointed at the
+ * segment instead.
+ */
+void ClothRenderer::bindDynamicStream(int segment) {
+	GLsizei stride = vertex_size_;
+	size_t base = (size_t)segment * segment_size_;
+	if (format_ == VertexFormat::Positions) {
+		glBindTexture(GL_TEXTURE_BUFFER, position_texture_);
+		if (ring_) {
+			glTexBufferRange(GL_TEXTURE_BUFFER, GL_RGB32F, dynamic_buffer_, base, cloth_.NumPoints() * vertex_size_);
+		} else {
+			glTexBuffer(GL_TEXTURE_BUFFER, GL_RGB32F, dynamic_buffer_);
+		}
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+	} else if (format_ == VertexFormat::Compact) {
+		glVertexAttribPointer(pos_attrib_, 4, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)(base + offsetof(CompactVertex, position)));
+		glVertexAttribPointer(norm_attrib_, 2, GL_SHORT, GL_TRUE, stride, (void*)(base + offsetof(CompactVertex, normal)));
+		if (UsesTangents()) {
+			glVertexAttribPointer(tan_attrib_, 2, GL_SHORT, GL_TRUE, stride, (void*)(base + offsetof(CompactVertex, tangent)));
+		}
+	} else {
+		glVertexAttribPointer(pos_attrib_, 3, GL_FLOAT, GL_FALSE, stride, (void*)(base + offsetof(RenderVertex, position)));
+		glVertexAttribPointer(norm_attrib_, 3, GL_FLOAT, GL_FALSE, stride, (void*)(base + offsetof(RenderVertex, normal)));
+		if (UsesTangents()) {
+			glVertexAttribPointer(tan_attrib_, 3, GL_FLOAT, GL_FALSE, stride, (void*)(base + offsetof(RenderVertex, tangent)));
+		}
+	}
+}
+
+/**
+ * Block until the GPU finished the draws that read a segment of the ring.
+ */
+void ClothRenderer::waitForSegment(int segment) {
+	if (!fences_[segment]) {
+		return;
+	}
+	const GLuint64 timeout = 1000000000;
+	GLenum result = glClientWaitSync(fences_[segment], GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+	while (result == GL_TIMEOUT_EXPIRED) {
+		result = glClientWaitSync(fences_[segment], 0, timeout);
+	}
+	glDeleteSync(fences_[segment]);
+	fences_[segment] = 0;
+}
+
+/**
+ * Write the vertices of the blocks [first_block, last_block) into a segment, straight into the
+ * mapped ring or through staging_ and a single upload into the bound dynamic buffer.
+ */
+void ClothRenderer::writeBlocks(int segment, int first_block, int last_block) {
+	int first = cloth_.BlockStart(first_block);
+	int last = cloth_.BlockStart(last_block);
+	GLsizeiptr size = (last - first) * vertex_size_;
+	char *vertices = ring_ ? ring_ + (size_t)segment * segment_size_ + first * vertex_size_
+		: staging_ + first * vertex_size_;
+	if (format_ == VertexFormat::Positions) {
+		// the shading attributes are computed by the vertex shader
+		std::memcpy(vertices, cloth_.Positions() + first, size);
+	} else if (format_ == VertexFormat::Compact && UsesTangents()) {
+		cloth_.WriteVertices((CompactVertex*)vertices, first, last, box_lower_[segment], box_extent_[segment]);
+	} else if (format_ == VertexFormat::Compact) {
+		cloth_.WriteVertices((CompactVertexNoTangent*)vertices, first, last, box_lower_[segment], box_extent_[segment]);
+	} else if (UsesTangents()) {
+		cloth_.WriteVertices((RenderVertex*)vertices, first, last);
+	} else {
+		cloth_.WriteVertices((RenderVertexNoTangent*)vertices, first, last);
+	}
+	if (!ring_) {
+		glBufferSubData(GL_ARRAY_BUFFER, first * vertex_size_, size, vertices);
+	}
+	last_upload_bytes_ += size;
+}
+
+/**
+ * Draw the Cloth using OpenGL using the currently bound shader. In the compact format the
+ * shader's quantization box uniforms are set to the box of the drawn copy, in the positions format
+ * the buffer texture is bound to kPositionTextureUnit.
+ */ 
+void ClothRenderer::Draw() {
+	if (format_ == VertexFormat::Compact) {
+		glUniform3fv(box_lower_uniform_, 1, &box_lower_[segment_].x);
+		glUniform3fv(box_extent_uniform_, 1, &box_extent_[segment_].x);
+	} else if (format_ == VertexFormat::Positions) {
+		glActiveTexture(GL_TEXTURE0 + kPositionTextureUnit);
+		glBindTexture(GL_TEXTURE_BUFFER, position_texture_);
+		glActiveTexture(GL_TEXTURE0);
+	}
+	glBindVertexArray(cloth_vao_);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+	glDrawElements(GL_TRIANGLES, 3 * cloth_.NumTriangles(), GL_UNSIGNED_INT, nullptr);
+	glBindVertexArray(0);
+	if (ring_) {
+		// the segment may not be rewritten until this draw is done
+		glDeleteSync(fences_[segment_]);
+		fences_[segment_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
+/**
+ * Load a texture to use as the cloth material. This texture is displayed during OpenGL rendering.
+ */ 
+void ClothRenderer::loadTexture(std::string file_name, GLuint *texture) {
+	int width, height, num_components;
+	// try both the debug and install directories to find the file
+	// start with debug
+	std::string full_file_path = DEBUG_DIR + std::string("/") + file_name;
+	std::ifstream img_file(full_file_path);
+	if(!img_file.good()) {
+		full_file_path = INSTALL_DIR + std::string("/") + file_name;
+		img_file.open(full_file_path);
+		if(!img_file.good()) {
+			exit(1);
+		}
+	};
+	img_file.close();
+	unsigned char* img_data = stbi_load(full_file_path.c_str(), &width, &height, &num_components, 0);
+	glGenTextures(1, texture);
+	glBindTexture(GL_TEXTURE_2D, *texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	GLuint img_type = (num_components == 4) ? GL_RGBA : GL_RGB;
+	glTexImage2D(GL_TEXTURE_2D, 0, img_type, width, height, 0, img_type, GL_UNSIGNED_BYTE, img_data);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	stbi_image_free(img_data);
+}
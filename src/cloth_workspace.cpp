@@ -0,0 +1,29 @@
+#include "cloth_workspace.h"
+
+ClothWorkspace::ClothWorkspace() : num_pts_(0), num_threads_(0), run_scratch_(nullptr), thread_scalars_(nullptr) {
+}
+
+ClothWorkspace::~ClothWorkspace() {
+	delete [] run_scratch_;
+	delete [] thread_scalars_;
+}
+
+/**
+ * Make sure every buffer can hold num_pts cloth points and runs of max_run springs for each
+ * of num_threads threads. Calling this again with the same sizes is free, so it is safe to
+ * call before every step.
+ */
+void ClothWorkspace::Resize(int num_pts, int max_run, int num_threads) {
+	forces_.Resize(num_pts);
+	if (num_threads != num_threads_) {
+		delete [] run_scratch_;
+		delete [] thread_scalars_;
+		run_scratch_ = new Vec3LaneBuffer[num_threads * kNumRunScratch];
+		thread_scalars_ = new float[num_threads * kNumThreadScalars];
+		num_threads_ = num_threads;
+	}
+	for (int i = 0; i < num_threads_ * kNumRunScratch; ++i) {
+		run_scratch_[i].Resize(max_run);
+	}
+	num_pts_ = num_pts;
+}
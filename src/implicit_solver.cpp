@@ -0,0 +1,282 @@
+#include "implicit_solver.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+// Symmetric 3x3 blocks are stored as their upper triangle
+enum SymBlockEntry { kXX, kXY, kXZ, kYY, kYZ, kZZ, kSymBlockSize };
+
+static glm::vec3 symMultiply(const float *m, const glm::vec3 &v) {
+	return glm::vec3(m[kXX] * v.x + m[kXY] * v.y + m[kXZ] * v.z,
+		m[kXY] * v.x + m[kYY] * v.y + m[kYZ] * v.z,
+		m[kXZ] * v.x + m[kYZ] * v.y + m[kZZ] * v.z);
+}
+
+/**
+ * Invert a symmetric positive definite 3x3 block by its adjugate.
+ */
+static void symInvert(const float *m, float *inv) {
+	float c_xx = m[kYY] * m[kZZ] - m[kYZ] * m[kYZ];
+	float c_xy = m[kXZ] * m[kYZ] - m[kXY] * m[kZZ];
+	float c_xz = m[kXY] * m[kYZ] - m[kXZ] * m[kYY];
+	float det = m[kXX] * c_xx + m[kXY] * c_xy + m[kXZ] * c_xz;
+	float inv_det = det != 0.0f ? 1.0f / det : 0.0f;
+	inv[kXX] = c_xx * inv_det;
+	inv[kXY] = c_xy * inv_det;
+	inv[kXZ] = c_xz * inv_det;
+	inv[kYY] = (m[kXX] * m[kZZ] - m[kXZ] * m[kXZ]) * inv_det;
+	inv[kYZ] = (m[kXY] * m[kXZ] - m[kXX] * m[kYZ]) * inv_det;
+	inv[kZZ] = (m[kXX] * m[kYY] - m[kXY] * m[kXY]) * inv_det;
+}
+
+ImplicitSolver::ImplicitSolver() : num_pts_(0), springs_(nullptr), tolerance_(1e-4f), max_iterations_(100),
+	residual_(0.0f), point_springs_start_(nullptr), point_springs_(nullptr), off_diag_(nullptr), diag_(nullptr),
+	precond_(nullptr), num_partials_(0), partials_(nullptr) {
+}
+
+ImplicitSolver::~ImplicitSolver() {
+	delete [] point_springs_start_;
+	delete [] point_springs_;
+	delete [] off_diag_;
+	delete [] diag_;
+	delete [] precond_;
+	delete [] partials_;
+}
+
+void ImplicitSolver::Setup(int num_pts, const SpringList &springs) {
+	delete [] point_springs_start_;
+	delete [] point_springs_;
+	delete [] off_diag_;
+	delete [] diag_;
+	delete [] precond_;
+	num_pts_ = num_pts;
+	springs_ = &springs;
+	int num_springs = springs.Size();
+
+	point_springs_start_ = new int[num_pts_ + 1];
+	point_springs_ = new int[2 * num_springs];
+	std::fill(point_springs_start_, point_springs_start_ + num_pts_ + 1, 0);
+	for (int s = 0; s < num_springs; ++s) {
+		point_springs_start_[springs.A()[s] + 1]++;
+		point_springs_start_[springs.B()[s] + 1]++;
+	}
+	for (int i = 0; i < num_pts_; ++i) {
+		point_springs_start_[i + 1] += point_springs_start_[i];
+	}
+	// fill the rows back to front, which leaves each start where it belongs
+	for (int s = num_springs - 1; s >= 0; --s) {
+		point_springs_[--point_springs_start_[springs.A()[s] + 1]] = s;
+		point_springs_[--point_springs_start_[springs.B()[s] + 1]] = ~s;
+	}
+	for (int i = 0; i < num_pts_; ++i) {
+		point_springs_start_[i] = point_springs_start_[i + 1];
+	}
+	point_springs_start_[num_pts_] = 2 * num_springs;
+
+	off_diag_ = new float[kSymBlockSize * num_springs];
+	diag_ = new float[kSymBlockSize * num_pts_];
+	precond_ = new float[kSymBlockSize * num_pts_];
+	spring_jv_.Resize(num_springs);
+	rhs_.Resize(num_pts_);
+	dv_.Resize(num_pts_);
+	r_.Resize(num_pts_);
+	z_.Resize(num_pts_);
+	p_.Resize(num_pts_);
+	q_.Resize(num_pts_);
+}
+
+void ImplicitSolver::SetTolerance(float tolerance, int max_iterations) {
+	tolerance_ = tolerance;
+	max_iterations_ = max_iterations;
+}
+
+/**
+ * Build the blocks of the system matrix and the right hand side. For a spring with direction u,
+ * length l and rest length L the stiffness block is k (u u^T + max(1 - L / l, 0) (I - u u^T)),
+ * the compressed part is dropped so the block stays positive semi-definite, and the damping
+ * block is kv u u^T. Each one enters the diagonal blocks of both ends and, negated, the
+ * off-diagonal block between them.
+ */
+void ImplicitSolver::assemble(const Vec3Lanes &pos, const Vec3Lanes &vel, const Vec3Lanes &forces,
+	const float *inv_mass, float mass, float k, float kv, float h, ThreadPool &pool) {
+	const int *spring_a = springs_->A();
+	const int *spring_b = springs_->B();
+	const float *spring_rest = springs_->Rest();
+	Vec3Lanes &spring_jv = spring_jv_.Lanes();
+	pool.ParallelFor(0, springs_->Size(), [&](int first, int last, int) {
+		for (int s = first; s < last; ++s) {
+			int a = spring_a[s];
+			int b = spring_b[s];
+			glm::vec3 dir = pos.Get(a) - pos.Get(b);
+			float length = glm::length(dir);
+			glm::vec3 u = dir / length;
+			float stretch = std::max(1.0f - spring_rest[s] / length, 0.0f);
+			// stiffness block k ((1 - stretch) u u^T + stretch I)
+			float kuu = k * (1.0f - stretch);
+			float kid = k * stretch;
+			float stiff[kSymBlockSize] = { kuu * u.x * u.x + kid, kuu * u.x * u.y, kuu * u.x * u.z,
+				kuu * u.y * u.y + kid, kuu * u.y * u.z, kuu * u.z * u.z + kid };
+			spring_jv.Set(s, symMultiply(stiff, vel.Get(a) - vel.Get(b)));
+
+			float *block = off_diag_ + kSymBlockSize * s;
+			float uu[kSymBlockSize] = { u.x * u.x, u.x * u.y, u.x * u.z, u.y * u.y, u.y * u.z, u.z * u.z };
+			for (int e = 0; e < kSymBlockSize; ++e) {
+				block[e] = -(h * h * stiff[e] + h * kv * uu[e]);
+			}
+		}
+	});
+
+	Vec3Lanes &rhs = rhs_.Lanes();
+	pool.ParallelFor(0, num_pts_, [&](int first, int last, int) {
+		for (int i = first; i < last; ++i) {
+			float *block = diag_ + kSymBlockSize * i;
+			float *inv = precond_ + kSymBlockSize * i;
+			if (inv_mass[i] == 0.0f) {
+				std::fill(block, block + kSymBlockSize, 0.0f);
+				std::fill(inv, inv + kSymBlockSize, 0.0f);
+				rhs.Set(i, glm::vec3(0, 0, 0));
+				continue;
+			}
+			float sum[kSymBlockSize] = { mass, 0.0f, 0.0f, mass, 0.0f, mass };
+			// df/dx v, the a end sees J (v_a - v_b) with a minus sign, the b end the opposite
+			glm::vec3 jv(0, 0, 0);
+			for (int e = point_springs_start_[i]; e < point_springs_start_[i + 1]; ++e) {
+				int s = point_springs_[e];
+				int spring = s >= 0 ? s : ~s;
+				const float *off = off_diag_ + kSymBlockSize * spring;
+				for (int c = 0; c < kSymBlockSize; ++c) {
+					sum[c] -= off[c];
+				}
+				jv += s >= 0 ? spring_jv.Get(spring) : -spring_jv.Get(spring);
+			}
+			std::copy(sum, sum + kSymBlockSize, block);
+			symInvert(block, inv);
+			rhs.Set(i, h * (forces.Get(i) - h * jv));
+		}
+	});
+}
+
+/**
+ * y = A x, rows of points that are held in place are 0.
+ */
+void ImplicitSolver::multiply(const Vec3Lanes &x, Vec3Lanes &y, const float *inv_mass, ThreadPool &pool) {
+	const int *spring_a = springs_->A();
+	const int *spring_b = springs_->B();
+	pool.ParallelFor(0, num_pts_, [&](int first, int last, int) {
+		for (int i = first; i < last; ++i) {
+			if (inv_mass[i] == 0.0f) {
+				y.Set(i, glm::vec3(0, 0, 0));
+				continue;
+			}
+			glm::vec3 result = symMultiply(diag_ + kSymBlockSize * i, x.Get(i));
+			for (int e = point_springs_start_[i]; e < point_springs_start_[i + 1]; ++e) {
+				int s = point_springs_[e];
+				int other = s >= 0 ? spring_b[s] : spring_a[~s];
+				int spring = s >= 0 ? s : ~s;
+				result += symMultiply(off_diag_ + kSymBlockSize * spring, x.Get(other));
+			}
+			y.Set(i, result);
+		}
+	});
+}
+
+void ImplicitSolver::precondition(const Vec3Lanes &x, Vec3Lanes &y, ThreadPool &pool) {
+	pool.ParallelFor(0, num_pts_, [&](int first, int last, int) {
+		for (int i = first; i < last; ++i) {
+			y.Set(i, symMultiply(precond_ + kSymBlockSize * i, x.Get(i)));
+		}
+	});
+}
+
+double ImplicitSolver::dot(const Vec3Lanes &a, const Vec3Lanes &b, ThreadPool &pool) {
+	std::fill(partials_, partials_ + num_partials_, 0.0);
+	pool.ParallelFor(0, num_pts_, [&](int first, int last, int thread) {
+		double sum = 0.0;
+		for (int i = first; i < last; ++i) {
+			sum += (double)a.x[i] * b.x[i] + (double)a.y[i] * b.y[i] + (double)a.z[i] * b.z[i];
+		}
+		partials_[thread] = sum;
+	});
+	double sum = 0.0;
+	for (int t = 0; t < num_partials_; ++t) {
+		sum += partials_[t];
+	}
+	return sum;
+}
+
+int ImplicitSolver::Solve(const Vec3Lanes &pos, const Vec3Lanes &vel, const Vec3Lanes &forces,
+	const float *inv_mass, float mass, float k, float kv, float h, ThreadPool &pool) {
+	if (num_partials_ != pool.NumThreads()) {
+		delete [] partials_;
+		num_partials_ = pool.NumThreads();
+		partials_ = new double[num_partials_];
+	}
+	assemble(pos, vel, forces, inv_mass, mass, k, kv, h, pool);
+
+	Vec3Lanes &rhs = rhs_.Lanes();
+	Vec3Lanes &dv = dv_.Lanes();
+	Vec3Lanes &r = r_.Lanes();
+	Vec3Lanes &z = z_.Lanes();
+	Vec3Lanes &p = p_.Lanes();
+	Vec3Lanes &q = q_.Lanes();
+
+	// start from the previous step's dv, r = b - A dv. Points locked since then must not carry
+	// their old dv into the products of their free neighbors, so they are cleared first.
+	pool.ParallelFor(0, num_pts_, [&](int first, int last, int) {
+		for (int i = first; i < last; ++i) {
+			if (inv_mass[i] == 0.0f) {
+				dv.Set(i, glm::vec3(0, 0, 0));
+			}
+		}
+	});
+	multiply(dv, q, inv_mass, pool);
+	pool.ParallelFor(0, num_pts_, [&](int first, int last, int) {
+		for (int i = first; i < last; ++i) {
+			r.Set(i, rhs.Get(i) - q.Get(i));
+		}
+	});
+	double rhs_norm2 = dot(rhs, rhs, pool);
+	double threshold = (double)tolerance_ * tolerance_ * rhs_norm2;
+	double r_norm2 = dot(r, r, pool);
+	precondition(r, z, pool);
+	pool.ParallelFor(0, num_pts_, [&](int first, int last, int) {
+		for (int i = first; i < last; ++i) {
+			p.Set(i, z.Get(i));
+		}
+	});
+	double rz = dot(r, z, pool);
+
+	int iteration = 0;
+	while (iteration < max_iterations_ && r_norm2 > threshold) {
+		multiply(p, q, inv_mass, pool);
+		double pq = dot(p, q, pool);
+		if (pq <= 0.0) {
+			break;
+		}
+		float alpha = (float)(rz / pq);
+		pool.ParallelFor(0, num_pts_, [&](int first, int last, int) {
+			for (int i = first; i < last; ++i) {
+				dv.Set(i, dv.Get(i) + alpha * p.Get(i));
+				r.Set(i, r.Get(i) - alpha * q.Get(i));
+			}
+		});
+		++iteration;
+		r_norm2 = dot(r, r, pool);
+		if (r_norm2 <= threshold) {
+			break;
+		}
+		precondition(r, z, pool);
+		double rz_next = dot(r, z, pool);
+		float beta = (float)(rz_next / rz);
+		rz = rz_next;
+		pool.ParallelFor(0, num_pts_, [&](int first, int last, int) {
+			for (int i = first; i < last; ++i) {
+				p.Set(i, z.Get(i) + beta * p.Get(i));
+			}
+		});
+	}
+	residual_ = rhs_norm2 > 0.0 ? (float)std::sqrt(r_norm2 / rhs_norm2) : 0.0f;
+	return iteration;
+}
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include <string>
 
 #define GLFW_INCLUDE_NONE
@@ -10,7 +11,9 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "config.h"
+#include "async_simulation.h"
 #include "cloth.h"
+#include "cloth_renderer.h"
 
 // global variables for window control
 bool pause = true;
@@ -147,52 +150,95 @@ int main(int argc, char* argv[]) {
     glfwGetFramebufferSize(window, &width, &height);
     glViewport(0, 0, width, height);
     
-    std::string vertex_src = loadShaderSource(std::string("oren_nayar_vert.glsl"));
-    std::string frag_src = loadShaderSource(std::string("oren_nayar_frag.glsl"));
-    GLuint cloth_shader = initShader(vertex_src.c_str(), frag_src.c_str());
-    Cloth cloth(40, 40, 6.5f, 2.25f, 0.75f, 1.f, 1.5f, -5.f, 24.f, 5.f);
-
-    cloth.initGL(cloth_shader);
-    glEnable(GL_DEPTH_TEST);
-    //glEnable(GL_CULL_FACE);
-    glEnable(GL_MULTISAMPLE);
-    glClearColor(0.75f, 0.75f, 0.75f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glUseProgram(cloth_shader);
-
-    camera_pos = glm::vec3(100, 40, 100);
-    camera_fwd = glm::vec3(0, 0, 0);
-    camera_up = glm::vec3(0, 1, 0);
-    view_mat = glm::lookAt(camera_pos,
-                           glm::vec3(0, 10, 0),
-                           camera_up);
-    proj_mat = glm::infinitePerspective(3.14f/8.0f, width / (float)height, .1f);
-    normal_mat = glm::inverse(glm::transpose(view_mat));
-    glm::vec3 light = glm::vec3(-1.0f, -1.0f, -1.0f);
+    // The renderer deletes its GL objects when it goes out of scope, which must happen while the
+    // context still exists, before glfwTerminate()
+    {
+        // --compact renders with the 16 byte per point vertex format, --gpu-normals uploads only the
+        // positions and computes the normals in the vertex shader, --async simulates on a thread of its
+        // own while a second cloth mirrors it for drawing
+        Cloth cloth(40, 40, 6.5f, 2.25f, 0.75f, 1.f, 1.5f, -5.f, 24.f, 5.f);
+        VertexFormat format = VertexFormat::Float;
+        std::string vertex_file = "oren_nayar_vert.glsl";
+        bool async = false;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--compact") {
+                format = VertexFormat::Compact;
+                vertex_file = "oren_nayar_compact_vert.glsl";
+            } else if (arg == "--gpu-normals") {
+                if (ClothRenderer::SupportsFormat(VertexFormat::Positions, cloth)) {
+                    format = VertexFormat::Positions;
+                    vertex_file = "oren_nayar_positions_vert.glsl";
+                } else {
+                    std::cout << "GPU normals need GL_ARB_texture_buffer_object_rgb32, using the default format" << std::endl;
+                }
+            } else if (arg == "--async") {
+                async = true;
+            }
+        }
+        std::unique_ptr<Cloth> display;
+        std::unique_ptr<AsyncSimulation> simulation;
+        if (async) {
+            display.reset(new Cloth(40, 40, 6.5f, 2.25f, 0.75f, 1.f, 1.5f, -5.f, 24.f, 5.f));
+            // a frame of 0.1 sixty times a second, like the synchronous loop at 60 Hz
+            simulation.reset(new AsyncSimulation(cloth, 0.1f, 60.0f));
+        }
+        std::string vertex_src = loadShaderSource(vertex_file);
+        std::string frag_src = loadShaderSource(std::string("oren_nayar_frag.glsl"));
+        GLuint cloth_shader = initShader(vertex_src.c_str(), frag_src.c_str());
+
+        ClothRenderer cloth_renderer(async ? *display : cloth);
+        cloth_renderer.SetVertexFormat(format);
+        cloth_renderer.initGL(cloth_shader);
+        glEnable(GL_DEPTH_TEST);
+        //glEnable(GL_CULL_FACE);
+        glEnable(GL_MULTISAMPLE);
+        glClearColor(0.75f, 0.75f, 0.75f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glUseProgram(cloth_shader);
+
+        camera_pos = glm::vec3(100, 40, 100);
+        camera_fwd = glm::vec3(0, 0, 0);
+        camera_up = glm::vec3(0, 1, 0);
+        view_mat = glm::lookAt(camera_pos,
+                               glm::vec3(0, 10, 0),
+                               camera_up);
+        proj_mat = glm::infinitePerspective(3.14f/8.0f, width / (float)height, .1f);
+        normal_mat = glm::inverse(glm::transpose(view_mat));
+        glm::vec3 light = glm::vec3(-1.0f, -1.0f, -1.0f);
     
-    view_uniform_loc = glGetUniformLocation(cloth_shader, "view_matrix");
-    proj_uniform_loc = glGetUniformLocation(cloth_shader, "proj_matrix");
-    normal_uniform_loc = glGetUniformLocation(cloth_shader, "normal_matrix");
-    cam_eye_uniform_loc = glGetUniformLocation(cloth_shader, "camera_eye");
+        view_uniform_loc = glGetUniformLocation(cloth_shader, "view_matrix");
+        proj_uniform_loc = glGetUniformLocation(cloth_shader, "proj_matrix");
+        normal_uniform_loc = glGetUniformLocation(cloth_shader, "normal_matrix");
+        cam_eye_uniform_loc = glGetUniformLocation(cloth_shader, "camera_eye");
     
-    glUniformMatrix4fv(view_uniform_loc, 1, GL_FALSE, glm::value_ptr(view_mat));
-    glUniformMatrix4fv(proj_uniform_loc, 1, GL_FALSE, glm::value_ptr(proj_mat));
-    glUniformMatrix4fv(normal_uniform_loc, 1, GL_FALSE, glm::value_ptr(normal_mat));
-    glUniform3fv(glGetUniformLocation(cloth_shader, "light_dir"), 1, glm::value_ptr(light));
-    glUniform3fv(cam_eye_uniform_loc, 1, glm::value_ptr(camera_pos));
+        glUniformMatrix4fv(view_uniform_loc, 1, GL_FALSE, glm::value_ptr(view_mat));
+        glUniformMatrix4fv(proj_uniform_loc, 1, GL_FALSE, glm::value_ptr(proj_mat));
+        glUniformMatrix4fv(normal_uniform_loc, 1, GL_FALSE, glm::value_ptr(normal_mat));
+        glUniform3fv(glGetUniformLocation(cloth_shader, "light_dir"), 1, glm::value_ptr(light));
+        glUniform3fv(cam_eye_uniform_loc, 1, glm::value_ptr(camera_pos));
     
-    int frame_num = 0; 
-    while(!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        if(!pause) {
-            cloth.Update(0.1f);
+        int frame_num = 0; 
+        while(!glfwWindowShouldClose(window)) {
+            glfwPollEvents();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            if (simulation) {
+                simulation->SetPaused(pause);
+                if (simulation->Acquire(*display)) {
+                    cloth_renderer.Update();
+                }
+            } else if(!pause) {
+                // StableTimestep() is about 0.068 for this cloth, so every frame takes two substeps
+                // of 0.05, twice the solver work of the single fixed step of 0.1 the viewer used to take
+                cloth.Advance(0.1f);
+                cloth_renderer.Update();
+            }
+            cloth_renderer.Draw();
+            glfwSwapBuffers(window);
         }
-        cloth.Draw();
-        glfwSwapBuffers(window);
-    }
 
-    glDeleteProgram(cloth_shader);
+        glDeleteProgram(cloth_shader);
+    }
     glfwTerminate();
     return 0;
 }
\ No newline at end of file
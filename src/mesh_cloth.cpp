@@ -0,0 +1,309 @@
+#include "mesh_cloth.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "force_kernels.h"
+
+/**
+ * Create a cloth from num_tris triangles over num_pts points, uvs may be null. The mesh is
+ * reordered along order before the springs are set up.
+ */
+MeshCloth::MeshCloth(const glm::vec3 *points, const glm::vec2 *uvs, int num_pts, const unsigned int *indices,
+	int num_tris, float k, float kv, float mass, float drag_coef, VertexOrder order)
+	: Cloth(points, uvs, num_pts, indices, num_tris, k, kv, mass, drag_coef), order_(VertexOrder::Input) {
+	point_index_ = new int[num_pts_];
+	for (int i = 0; i < num_pts_; ++i) {
+		point_index_[i] = i;
+	}
+	point_springs_start_ = new int[num_pts_ + 1];
+	point_tris_start_ = new int[num_pts_ + 1];
+	point_tris_ = new int[3 * num_tris_];
+	face_normals_ = new glm::vec3[num_tris_];
+	face_tangents_ = new glm::vec3[num_tris_];
+	tangent_weights_ = new glm::vec2[num_tris_];
+	tri_drag_.Resize(num_tris_);
+
+	buildSprings();
+	point_springs_ = new int[2 * springs_.Size()];
+	spring_forces_.Resize(springs_.Size());
+	Reorder(order);
+}
+
+MeshCloth::~MeshCloth() {
+	delete [] point_index_;
+	delete [] point_springs_start_;
+	delete [] point_springs_;
+	delete [] point_tris_start_;
+	delete [] point_tris_;
+	delete [] face_normals_;
+	delete [] face_tangents_;
+	delete [] tangent_weights_;
+}
+
+/**
+ * Find the unique edges of the triangles, their current length becomes the rest length.
+ */
+void MeshCloth::buildSprings() {
+	std::vector<std::pair<int, int>> edges;
+	edges.reserve(3 * num_tris_);
+	for (int t = 0; t < num_tris_; ++t) {
+		for (int c = 0; c < 3; ++c) {
+			int a = indices_[3 * t + c];
+			int b = indices_[3 * t + (c + 1) % 3];
+			edges.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+	springs_.Resize((int)edges.size());
+	for (int s = 0; s < springs_.Size(); ++s) {
+		springs_.Set(s, edges[s].first, edges[s].second,
+			glm::length(cloth_pts_[edges[s].second] - cloth_pts_[edges[s].first]));
+	}
+}
+
+/**
+ * Collect the springs and the triangles around each point. Both lists are filled in order, so
+ * with a sorted mesh every point reads its neighbors from nearby memory.
+ */
+void MeshCloth::buildAdjacency() {
+	const int *spring_a = springs_.A();
+	const int *spring_b = springs_.B();
+	std::fill(point_springs_start_, point_springs_start_ + num_pts_ + 1, 0);
+	for (int s = 0; s < springs_.Size(); ++s) {
+		point_springs_start_[spring_a[s] + 1]++;
+		point_springs_start_[spring_b[s] + 1]++;
+	}
+	for (int i = 0; i < num_pts_; ++i) {
+		point_springs_start_[i + 1] += point_springs_start_[i];
+	}
+	std::vector<int> fill(point_springs_start_, point_springs_start_ + num_pts_);
+	for (int s = 0; s < springs_.Size(); ++s) {
+		point_springs_[fill[spring_a[s]]++] = s;
+		point_springs_[fill[spring_b[s]]++] = ~s;
+	}
+
+	std::fill(point_tris_start_, point_tris_start_ + num_pts_ + 1, 0);
+	for (int i = 0; i < 3 * num_tris_; ++i) {
+		point_tris_start_[indices_[i] + 1]++;
+	}
+	for (int i = 0; i < num_pts_; ++i) {
+		point_tris_start_[i + 1] += point_tris_start_[i];
+	}
+	fill.assign(point_tris_start_, point_tris_start_ + num_pts_);
+	for (int i = 0; i < 3 * num_tris_; ++i) {
+		point_tris_[fill[indices_[i]]++] = i / 3;
+	}
+}
+
+/**
+ * Store the points along the given curve through their current positions and renumber the
+ * triangles, springs and every per point array to match. The triangles are sorted by their
+ * first point in the new order, so the index buffer walks the cloth along the curve too.
+ */
+void MeshCloth::Reorder(VertexOrder order) {
+	std::vector<int> new_index(num_pts_);
+	SpaceFillingCurveOrder(cloth_pts_, num_pts_, order, new_index.data());
+
+	// per point state
+	std::vector<glm::vec3> points(num_pts_), vels(num_pts_), norms(num_pts_), tans(num_pts_);
+	std::vector<glm::vec2> uvs(num_pts_);
+	std::vector<float> inv_mass(num_pts_);
+	std::vector<char> lock(num_pts_);
+	for (int i = 0; i < num_pts_; ++i) {
+		int n = new_index[i];
+		points[n] = cloth_pts_[i];
+		vels[n] = vel_.Lanes().Get(i);
+		norms[n] = norms_[i];
+		tans[n] = tans_[i];
+		uvs[n] = uvs_[i];
+		inv_mass[n] = inv_mass_[i];
+		lock[n] = lock_[i];
+	}
+	for (int i = 0; i < num_pts_; ++i) {
+		cloth_pts_[i] = points[i];
+		vel_.Lanes().Set(i, vels[i]);
+		norms_[i] = norms[i];
+		tans_[i] = tans[i];
+		uvs_[i] = uvs[i];
+		inv_mass_[i] = inv_mass[i];
+		lock_[i] = lock[i] != 0;
+	}
+	pos_.Load(cloth_pts_);
+	for (int i = 0; i < num_pts_; ++i) {
+		point_index_[i] = new_index[point_index_[i]];
+	}
+
+	// triangles, the winding is kept by rotating the smallest index to the front
+	std::vector<unsigned int> tris(3 * num_tris_);
+	std::vector<int> tri_order(num_tris_);
+	for (int t = 0; t < num_tris_; ++t) {
+		unsigned int v[3];
+		for (int c = 0; c < 3; ++c) {
+			v[c] = new_index[indices_[3 * t + c]];
+		}
+		int first = v[0] < v[1] ? (v[0] < v[2] ? 0 : 2) : (v[1] < v[2] ? 1 : 2);
+		for (int c = 0; c < 3; ++c) {
+			tris[3 * t + c] = v[(first + c) % 3];
+		}
+		tri_order[t] = t;
+	}
+	std::sort(tri_order.begin(), tri_order.end(), [&](int a, int b) {
+		return std::lexicographical_compare(&tris[3 * a], &tris[3 * a + 3], &tris[3 * b], &tris[3 * b + 3]);
+	});
+	for (int t = 0; t < num_tris_; ++t) {
+		for (int c = 0; c < 3; ++c) {
+			indices_[3 * t + c] = tris[3 * tri_order[t] + c];
+		}
+	}
+
+	// springs
+	std::vector<std::pair<std::pair<int, int>, float>> springs(springs_.Size());
+	for (int s = 0; s < springs_.Size(); ++s) {
+		int a = new_index[springs_.A()[s]];
+		int b = new_index[springs_.B()[s]];
+		springs[s] = std::make_pair(std::make_pair(std::min(a, b), std::max(a, b)), springs_.Rest()[s]);
+	}
+	std::sort(springs.begin(), springs.end());
+	for (int s = 0; s < springs_.Size(); ++s) {
+		springs_.Set(s, springs[s].first.first, springs[s].first.second, springs[s].second);
+	}
+
+	buildAdjacency();
+	calcTangentWeights();
+	implicit_ready_ = false;
+	forces_current_ = false;
+	markAllChanged();
+	xpbd_ready_ = false;
+	projective_ready_ = false;
+	order_ = order;
+}
+
+void MeshCloth::calcForces(Vec3Lanes &forces) {
+	gatherForces(forces, true);
+}
+
+void MeshCloth::calcExternalForces(Vec3Lanes &forces) {
+	gatherForces(forces, false);
+}
+
+/**
+ * Evaluate every spring and drag triangle once into its own slot, then let every point gather
+ * the results around it. Neither pass writes to memory another thread writes to. Without
+ * springs only gravity and the drag are gathered.
+ */
+void MeshCloth::gatherForces(Vec3Lanes &forces, bool springs) {
+	const Vec3Lanes &pos = pos_.Lanes();
+	const Vec3Lanes &vel = vel_.Lanes();
+	Vec3Lanes &spring_forces = spring_forces_.Lanes();
+	Vec3Lanes &tri_drag = tri_drag_.Lanes();
+
+	const int *spring_a = springs_.A();
+	const int *spring_b = springs_.B();
+	const float *spring_rest = springs_.Rest();
+	pool_->ParallelFor(0, springs ? springs_.Size() : 0, [&](int first, int last, int) {
+		for (int s = first; s < last; ++s) {
+			int a = spring_a[s];
+			int b = spring_b[s];
+			glm::vec3 dir = pos.Get(a) - pos.Get(b);
+			float length = glm::length(dir);
+			float string_force = -k_ * (length - spring_rest[s]);
+			dir = dir / length;
+			float damp_force = -kv_ * glm::dot(vel.Get(a) - vel.Get(b), dir);
+			spring_forces.Set(s, dir * (string_force + damp_force));
+		}
+	});
+
+	// -0.5 * drag_coef, then divided by 3 to spread it over the triangle's corners
+	const float scale = -0.5f * drag_coef_ / 3.0f;
+	pool_->ParallelFor(0, num_tris_, [&](int first, int last, int) {
+		for (int t = first; t < last; ++t) {
+			int i1 = indices_[3 * t];
+			int i2 = indices_[3 * t + 1];
+			int i3 = indices_[3 * t + 2];
+			glm::vec3 avg_vel = (vel.Get(i1) + vel.Get(i2) + vel.Get(i3)) / 3.0f - air_res_;
+			glm::vec3 normal = glm::cross(pos.Get(i2) - pos.Get(i1), pos.Get(i3) - pos.Get(i1));
+			float normal_length = glm::length(normal);
+			glm::vec3 drag(0, 0, 0);
+			if (normal_length > 0.0f) {
+				float v_a_n = glm::length(avg_vel) * glm::dot(avg_vel, normal) * 0.5f;
+				drag = normal * (scale * v_a_n / normal_length);
+			}
+			tri_drag.Set(t, drag);
+		}
+	});
+
+	pool_->ParallelFor(0, num_pts_, [&](int first, int last, int) {
+		for (int i = first; i < last; ++i) {
+			glm::vec3 force(0, -kGravityForce, 0);
+			for (int e = point_springs_start_[i]; springs && e < point_springs_start_[i + 1]; ++e) {
+				int s = point_springs_[e];
+				if (s >= 0) {
+					force += spring_forces.Get(s);
+				} else {
+					force -= spring_forces.Get(~s);
+				}
+			}
+			for (int e = point_tris_start_[i]; e < point_tris_start_[i + 1]; ++e) {
+				force += tri_drag.Get(point_tris_[e]);
+			}
+			forces.Set(i, force);
+		}
+	});
+}
+
+/**
+ * The UVs never change, so the inverse of every triangle's UV matrix is computed once. The
+ * tangent of a triangle (p1, p2, p3) is then w.x * (p3 - p1) + w.y * (p2 - p1). A triangle with
+ * degenerate UVs gets no tangent.
+ */
+void MeshCloth::calcTangentWeights() {
+	for (int t = 0; t < num_tris_; ++t) {
+		const glm::vec2 &uv1 = uvs_[indices_[3 * t]];
+		glm::vec2 duv1 = uvs_[indices_[3 * t + 2]] - uv1;
+		glm::vec2 duv2 = uvs_[indices_[3 * t + 1]] - uv1;
+		float det = duv1.x * duv2.y - duv2.x * duv1.y;
+		float f = det != 0.0f ? 1.0f / det : 0.0f;
+		tangent_weights_[t] = glm::vec2(f * duv2.y, -f * duv1.y);
+	}
+}
+
+/**
+ * Sum the face normals and tangents around each point, gathered like the forces. Both are
+ * evaluated in one pass over the triangles, the tangents only when asked for.
+ */
+void MeshCloth::calcShading(bool tangents) const {
+	pool_->ParallelFor(0, num_tris_, [&](int first, int last, int) {
+		for (int t = first; t < last; ++t) {
+			const glm::vec3 &p1 = cloth_pts_[indices_[3 * t]];
+			const glm::vec3 &p2 = cloth_pts_[indices_[3 * t + 1]];
+			const glm::vec3 &p3 = cloth_pts_[indices_[3 * t + 2]];
+			glm::vec3 edge1 = p3 - p1;
+			glm::vec3 edge2 = p2 - p1;
+			face_normals_[t] = glm::cross(edge2, edge1);
+			if (tangents) {
+				face_tangents_[t] = tangent_weights_[t].x * edge1 + tangent_weights_[t].y * edge2;
+			}
+		}
+	});
+	pool_->ParallelFor(0, num_pts_, [&](int first, int last, int) {
+		for (int i = first; i < last; ++i) {
+			glm::vec3 normal(0, 0, 0);
+			for (int e = point_tris_start_[i]; e < point_tris_start_[i + 1]; ++e) {
+				normal += face_normals_[point_tris_[e]];
+			}
+			norms_[i] = glm::normalize(normal);
+			if (tangents) {
+				glm::vec3 tangent(0, 0, 0);
+				for (int e = point_tris_start_[i]; e < point_tris_start_[i + 1]; ++e) {
+					tangent += face_tangents_[point_tris_[e]];
+				}
+				tans_[i] = glm::normalize(tangent);
+			}
+		}
+	});
+}
@@ -0,0 +1,71 @@
+#include "particle_store.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#include "alloc_counter.h"
+
+float* AllocateLane(int count) {
+	size_t bytes = PaddedLaneSize(count) * sizeof(float);
+	void *lane = nullptr;
+#ifdef _WIN32
+	lane = _aligned_malloc(bytes == 0 ? kLaneAlignment : bytes, kLaneAlignment);
+#else
+	if (posix_memalign(&lane, kLaneAlignment, bytes == 0 ? kLaneAlignment : bytes) != 0) {
+		lane = nullptr;
+	}
+#endif
+	if (!lane) {
+		throw std::bad_alloc();
+	}
+	RecordHeapAllocation();
+	std::memset(lane, 0, bytes);
+	return static_cast<float*>(lane);
+}
+
+void FreeLane(float *lane) {
+#ifdef _WIN32
+	_aligned_free(lane);
+#else
+	free(lane);
+#endif
+}
+
+Vec3LaneBuffer::Vec3LaneBuffer() : count_(0), data_(nullptr) {
+}
+
+Vec3LaneBuffer::~Vec3LaneBuffer() {
+	FreeLane(data_);
+}
+
+/**
+ * Resize the buffer to hold count vectors, the contents are zeroed whenever the size changes.
+ */
+void Vec3LaneBuffer::Resize(int count) {
+	if (count == count_ && data_) {
+		return;
+	}
+	FreeLane(data_);
+	int pitch = LanePitch(count);
+	data_ = AllocateLane(3 * pitch);
+	lanes_.x = data_;
+	lanes_.y = data_ + pitch;
+	lanes_.z = data_ + 2 * pitch;
+	count_ = count;
+}
+
+void Vec3LaneBuffer::Load(const glm::vec3 *src) {
+	for (int i = 0; i < count_; ++i) {
+		lanes_.Set(i, src[i]);
+	}
+}
+
+void Vec3LaneBuffer::Store(glm::vec3 *dst) const {
+	for (int i = 0; i < count_; ++i) {
+		dst[i] = lanes_.Get(i);
+	}
+}
@@ -0,0 +1,255 @@
+#include "projective_solver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+ProjectiveSolver::ProjectiveSolver() : num_pts_(0), springs_(nullptr), num_iterations_(10),
+	point_springs_start_(nullptr), point_springs_(nullptr), unknown_(nullptr), unknown_point_(nullptr),
+	num_unknowns_(0), analyzed_(false), matrix_start_(nullptr), matrix_cols_(nullptr), laplacian_(nullptr),
+	matrix_(nullptr), diag_index_(nullptr), factor_mass_(0.0f), factor_k_(0.0f), factor_kv_(0.0f),
+	factor_h_(0.0f), factored_(false), rhs_(nullptr), work_(nullptr) {
+}
+
+ProjectiveSolver::~ProjectiveSolver() {
+	delete [] point_springs_start_;
+	delete [] point_springs_;
+	delete [] unknown_;
+	delete [] unknown_point_;
+	delete [] matrix_start_;
+	delete [] matrix_cols_;
+	delete [] laplacian_;
+	delete [] matrix_;
+	delete [] diag_index_;
+	delete [] rhs_;
+	delete [] work_;
+}
+
+void ProjectiveSolver::Setup(int num_pts, const SpringList &springs) {
+	delete [] point_springs_start_;
+	delete [] point_springs_;
+	delete [] unknown_;
+	num_pts_ = num_pts;
+	springs_ = &springs;
+	int num_springs = springs.Size();
+
+	point_springs_start_ = new int[num_pts_ + 1];
+	point_springs_ = new int[2 * num_springs];
+	std::fill(point_springs_start_, point_springs_start_ + num_pts_ + 1, 0);
+	for (int s = 0; s < num_springs; ++s) {
+		point_springs_start_[springs.A()[s] + 1]++;
+		point_springs_start_[springs.B()[s] + 1]++;
+	}
+	for (int i = 0; i < num_pts_; ++i) {
+		point_springs_start_[i + 1] += point_springs_start_[i];
+	}
+	// fill the rows back to front, which leaves each start where it belongs
+	for (int s = num_springs - 1; s >= 0; --s) {
+		point_springs_[--point_springs_start_[springs.A()[s] + 1]] = s;
+		point_springs_[--point_springs_start_[springs.B()[s] + 1]] = ~s;
+	}
+	for (int i = 0; i < num_pts_; ++i) {
+		point_springs_start_[i] = point_springs_start_[i + 1];
+	}
+	point_springs_start_[num_pts_] = 2 * num_springs;
+
+	unknown_ = new int[num_pts_];
+	prev_pos_.Resize(num_pts_);
+	inertia_.Resize(num_pts_);
+	targets_.Resize(num_springs);
+	analyzed_ = false;
+	factored_ = false;
+}
+
+bool ProjectiveSolver::locksChanged(const float *inv_mass) const {
+	for (int i = 0; i < num_pts_; ++i) {
+		if ((inv_mass[i] == 0.0f) != (unknown_[i] < 0)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Number the unlocked points and build the pattern of the system matrix over them, with the
+ * Laplacian of the springs: the number of springs at a point on the diagonal, minus the number
+ * of springs between two points off it.
+ */
+void ProjectiveSolver::analyze(const float *inv_mass) {
+	delete [] unknown_point_;
+	delete [] matrix_start_;
+	delete [] matrix_cols_;
+	delete [] laplacian_;
+	delete [] matrix_;
+	delete [] diag_index_;
+	delete [] rhs_;
+	delete [] work_;
+
+	num_unknowns_ = 0;
+	for (int i = 0; i < num_pts_; ++i) {
+		unknown_[i] = inv_mass[i] == 0.0f ? -1 : num_unknowns_++;
+	}
+	unknown_point_ = new int[num_unknowns_];
+	for (int i = 0; i < num_pts_; ++i) {
+		if (unknown_[i] >= 0) {
+			unknown_point_[unknown_[i]] = i;
+		}
+	}
+
+	const int *spring_a = springs_->A();
+	const int *spring_b = springs_->B();
+	std::vector<int> cols;
+	std::vector<double> values;
+	std::vector<std::pair<int, double>> row;
+	matrix_start_ = new int[num_unknowns_ + 1];
+	diag_index_ = new int[num_unknowns_];
+	matrix_start_[0] = 0;
+	for (int u = 0; u < num_unknowns_; ++u) {
+		int i = unknown_point_[u];
+		row.clear();
+		row.push_back(std::make_pair(u, 0.0));
+		for (int p = point_springs_start_[i]; p < point_springs_start_[i + 1]; ++p) {
+			int s = point_springs_[p];
+			int other = s >= 0 ? spring_b[s] : spring_a[~s];
+			row[0].second += 1.0;
+			if (unknown_[other] >= 0) {
+				row.push_back(std::make_pair(unknown_[other], -1.0));
+			}
+		}
+		std::sort(row.begin(), row.end());
+		for (size_t e = 0; e < row.size(); ++e) {
+			if (!cols.empty() && (int)cols.size() > matrix_start_[u] && cols.back() == row[e].first) {
+				values.back() += row[e].second;
+				continue;
+			}
+			if (row[e].first == u) {
+				diag_index_[u] = (int)cols.size();
+			}
+			cols.push_back(row[e].first);
+			values.push_back(row[e].second);
+		}
+		matrix_start_[u + 1] = (int)cols.size();
+	}
+	matrix_cols_ = new int[cols.size()];
+	laplacian_ = new double[cols.size()];
+	matrix_ = new double[cols.size()];
+	std::copy(cols.begin(), cols.end(), matrix_cols_);
+	std::copy(values.begin(), values.end(), laplacian_);
+	rhs_ = new double[3 * num_unknowns_];
+	work_ = new double[3 * num_unknowns_];
+
+	cholesky_.Analyze(num_unknowns_, matrix_start_, matrix_cols_);
+	analyzed_ = true;
+	factored_ = false;
+}
+
+bool ProjectiveSolver::factor(float mass, float k, float kv, float h) {
+	double stiffness = (double)k + (double)kv / h;
+	for (int p = 0; p < matrix_start_[num_unknowns_]; ++p) {
+		matrix_[p] = stiffness * laplacian_[p];
+	}
+	double inertia = (double)mass / ((double)h * h);
+	for (int u = 0; u < num_unknowns_; ++u) {
+		matrix_[diag_index_[u]] += inertia;
+	}
+	// positive definite for a positive mass, timestep and stiffness, user parameters may not be
+	if (!cholesky_.Factor(matrix_)) {
+		factored_ = false;
+		return false;
+	}
+	factor_mass_ = mass;
+	factor_k_ = k;
+	factor_kv_ = kv;
+	factor_h_ = h;
+	factored_ = true;
+	return true;
+}
+
+bool ProjectiveSolver::Step(Vec3Lanes &pos, Vec3Lanes &vel, const Vec3Lanes &forces, const float *inv_mass,
+	float mass, float k, float kv, float h, ThreadPool &pool) {
+	if (!analyzed_ || locksChanged(inv_mass)) {
+		analyze(inv_mass);
+	}
+	if (!factored_ || mass != factor_mass_ || k != factor_k_ || kv != factor_kv_ || h != factor_h_) {
+		if (!factor(mass, k, kv, h)) {
+			return false;
+		}
+	}
+	Vec3Lanes &prev_pos = prev_pos_.Lanes();
+	Vec3Lanes &inertia = inertia_.Lanes();
+	Vec3Lanes &targets = targets_.Lanes();
+	const int *spring_a = springs_->A();
+	const int *spring_b = springs_->B();
+	const float *rest = springs_->Rest();
+
+	// the inertial prediction is also the initial guess
+	pool.ParallelFor(0, num_pts_, [&](int first, int last, int) {
+		for (int i = first; i < last; ++i) {
+			glm::vec3 x = pos.Get(i);
+			prev_pos.Set(i, x);
+			glm::vec3 y = x + h * (vel.Get(i) + (h * inv_mass[i]) * forces.Get(i));
+			inertia.Set(i, inv_mass[i] == 0.0f ? x : y);
+			pos.Set(i, inertia.Get(i));
+		}
+	});
+
+	double inertia_weight = (double)mass / ((double)h * h);
+	double damping = (double)kv / h;
+	double stiffness = k + damping;
+	for (int iteration = 0; iteration < num_iterations_; ++iteration) {
+		// local step
+		pool.ParallelFor(0, springs_->Size(), [&](int first, int last, int) {
+			for (int s = first; s < last; ++s) {
+				glm::vec3 dir = pos.Get(spring_a[s]) - pos.Get(spring_b[s]);
+				float length = glm::length(dir);
+				targets.Set(s, length > 0.0f ? dir * (rest[s] / length) : glm::vec3(0, 0, 0));
+			}
+		});
+
+		// right hand side of the global step, gathered per unknown
+		pool.ParallelFor(0, num_unknowns_, [&](int first, int last, int) {
+			for (int u = first; u < last; ++u) {
+				int i = unknown_point_[u];
+				glm::vec3 y = inertia.Get(i);
+				double b[3] = { inertia_weight * y.x, inertia_weight * y.y, inertia_weight * y.z };
+				for (int p = point_springs_start_[i]; p < point_springs_start_[i + 1]; ++p) {
+					int s = point_springs_[p];
+					int a_end = s >= 0 ? s : ~s;
+					int other = s >= 0 ? spring_b[a_end] : spring_a[a_end];
+					float sign = s >= 0 ? 1.0f : -1.0f;
+					glm::vec3 prev_dir = prev_pos.Get(spring_a[a_end]) - prev_pos.Get(spring_b[a_end]);
+					glm::vec3 term = sign * (k * targets.Get(a_end) + (float)damping * prev_dir);
+					if (unknown_[other] < 0) {
+						// the locked end moves to the right hand side
+						term += (float)stiffness * pos.Get(other);
+					}
+					b[0] += term.x;
+					b[1] += term.y;
+					b[2] += term.z;
+				}
+				rhs_[3 * u] = b[0];
+				rhs_[3 * u + 1] = b[1];
+				rhs_[3 * u + 2] = b[2];
+			}
+		});
+
+		// global step, the three coordinates share one pass over the factor
+		cholesky_.Solve(rhs_, work_, 3);
+		pool.ParallelFor(0, num_unknowns_, [&](int first, int last, int) {
+			for (int u = first; u < last; ++u) {
+				const double *x = rhs_ + 3 * u;
+				pos.Set(unknown_point_[u], glm::vec3((float)x[0], (float)x[1], (float)x[2]));
+			}
+		});
+	}
+
+	float inv_h = 1.0f / h;
+	pool.ParallelFor(0, num_pts_, [&](int first, int last, int) {
+		for (int i = first; i < last; ++i) {
+			vel.Set(i, (pos.Get(i) - prev_pos.Get(i)) * inv_h);
+		}
+	});
+	return true;
+}
@@ -0,0 +1,151 @@
+#include "sleep_tracker.h"
+
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+SleepTracker::SleepTracker() : num_ropes_(0), pts_per_rope_(0), tiles_across_(0), tiles_along_(0), num_tiles_(0),
+	max_kinetic_energy_(1e-3f), max_force_sq_(1e-2f), awake_(nullptr), quiet_steps_(nullptr), moving_(nullptr),
+	num_awake_(0), awake_list_(nullptr) {
+}
+
+SleepTracker::~SleepTracker() {
+	delete [] awake_;
+	delete [] quiet_steps_;
+	delete [] moving_;
+	delete [] awake_list_;
+}
+
+void SleepTracker::Setup(int num_ropes, int pts_per_rope) {
+	delete [] awake_;
+	delete [] quiet_steps_;
+	delete [] moving_;
+	delete [] awake_list_;
+	num_ropes_ = num_ropes;
+	pts_per_rope_ = pts_per_rope;
+	tiles_across_ = (num_ropes_ + kTileRopes - 1) / kTileRopes;
+	tiles_along_ = (pts_per_rope_ + kTilePoints - 1) / kTilePoints;
+	num_tiles_ = tiles_across_ * tiles_along_;
+	awake_ = new bool[num_tiles_];
+	quiet_steps_ = new int[num_tiles_];
+	moving_ = new bool[num_tiles_];
+	awake_list_ = new int[num_tiles_];
+	WakeAll();
+}
+
+/**
+ * Set the largest kinetic energy of a point, and the largest net force on a free point, that
+ * still count as settled.
+ */
+void SleepTracker::SetThresholds(float kinetic_energy, float force) {
+	max_kinetic_energy_ = kinetic_energy;
+	max_force_sq_ = force * force;
+}
+
+void SleepTracker::TileRopes(int tile, int *first, int *last) const {
+	*first = (tile / tiles_along_) * kTileRopes;
+	*last = std::min(*first + kTileRopes, num_ropes_);
+}
+
+void SleepTracker::TilePoints(int tile, int *first, int *last) const {
+	*first = (tile % tiles_along_) * kTilePoints;
+	*last = std::min(*first + kTilePoints, pts_per_rope_);
+}
+
+void SleepTracker::Wake(int point) {
+	if (num_tiles_ == 0) {
+		return;
+	}
+	int tile_rope = point / pts_per_rope_ / kTileRopes;
+	int tile_point = point % pts_per_rope_ / kTilePoints;
+	for (int r = tile_rope - 1; r <= tile_rope + 1; ++r) {
+		for (int p = tile_point - 1; p <= tile_point + 1; ++p) {
+			wakeTile(r, p);
+		}
+	}
+	rebuildAwakeList();
+}
+
+void SleepTracker::WakeAll() {
+	for (int t = 0; t < num_tiles_; ++t) {
+		awake_[t] = true;
+		quiet_steps_[t] = 0;
+		moving_[t] = true;
+	}
+	rebuildAwakeList();
+}
+
+bool SleepTracker::Update(Vec3Lanes &vel, const Vec3Lanes &forces, const float *inv_mass, float mass,
+	ThreadPool &pool) {
+	float max_speed_sq = 2.0f * max_kinetic_energy_ / mass;
+	pool.ParallelFor(0, num_awake_, [&](int first, int last, int) {
+		for (int a = first; a < last; ++a) {
+			int tile = awake_list_[a];
+			int rope_first, rope_last, point_first, point_last;
+			TileRopes(tile, &rope_first, &rope_last);
+			TilePoints(tile, &point_first, &point_last);
+			bool moving = false;
+			for (int j = rope_first; j < rope_last && !moving; ++j) {
+				for (int i = j * pts_per_rope_ + point_first; i < j * pts_per_rope_ + point_last; ++i) {
+					glm::vec3 v = vel.Get(i);
+					glm::vec3 f = forces.Get(i);
+					// written so that NaNs count as moving
+					if (!(glm::dot(v, v) <= max_speed_sq) || (inv_mass[i] != 0.0f && !(glm::dot(f, f) <= max_force_sq_))) {
+						moving = true;
+						break;
+					}
+				}
+			}
+			moving_[tile] = moving;
+			quiet_steps_[tile] = moving ? 0 : quiet_steps_[tile] + 1;
+			if (quiet_steps_[tile] >= kSleepDelay) {
+				awake_[tile] = false;
+				for (int j = rope_first; j < rope_last; ++j) {
+					for (int i = j * pts_per_rope_ + point_first; i < j * pts_per_rope_ + point_last; ++i) {
+						vel.Set(i, glm::vec3(0, 0, 0));
+					}
+				}
+			}
+		}
+	});
+
+	// moving tiles wake their sleeping neighbors, serially since neighbors are shared
+	bool woke = false;
+	for (int a = 0; a < num_awake_; ++a) {
+		int tile = awake_list_[a];
+		if (!moving_[tile]) {
+			continue;
+		}
+		int tile_rope = tile / tiles_along_;
+		int tile_point = tile % tiles_along_;
+		for (int r = tile_rope - 1; r <= tile_rope + 1; ++r) {
+			for (int p = tile_point - 1; p <= tile_point + 1; ++p) {
+				if (r >= 0 && r < tiles_across_ && p >= 0 && p < tiles_along_ && !awake_[r * tiles_along_ + p]) {
+					wakeTile(r, p);
+					woke = true;
+				}
+			}
+		}
+	}
+	rebuildAwakeList();
+	return woke;
+}
+
+void SleepTracker::wakeTile(int tile_rope, int tile_point) {
+	if (tile_rope < 0 || tile_rope >= tiles_across_ || tile_point < 0 || tile_point >= tiles_along_) {
+		return;
+	}
+	int tile = tile_rope * tiles_along_ + tile_point;
+	awake_[tile] = true;
+	quiet_steps_[tile] = 0;
+	moving_[tile] = false;
+}
+
+void SleepTracker::rebuildAwakeList() {
+	num_awake_ = 0;
+	for (int t = 0; t < num_tiles_; ++t) {
+		if (awake_[t]) {
+			awake_list_[num_awake_++] = t;
+		}
+	}
+}
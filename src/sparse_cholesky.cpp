@@ -0,0 +1,386 @@
+#include "sparse_cholesky.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// regions with fewer unknowns are not dissected any further
+const int kMinDissectionSize = 64;
+
+/**
+ * Breadth first search from root over the unknowns labeled label. Fills queue with the visited
+ * unknowns in visiting order, level with their distance to the root, and level_start with the
+ * position of the first unknown of each level in queue. Returns the number of levels.
+ */
+int levelStructure(int root, int label, const int *row_start, const int *cols, const int *labels,
+	std::vector<int> &queue, std::vector<int> &level, std::vector<int> &level_start) {
+	queue.clear();
+	level_start.clear();
+	queue.push_back(root);
+	level[root] = 0;
+	int num_levels = 0;
+	for (size_t head = 0; head < queue.size(); ++head) {
+		int v = queue[head];
+		if (level[v] == num_levels) {
+			level_start.push_back((int)head);
+			++num_levels;
+		}
+		for (int p = row_start[v]; p < row_start[v + 1]; ++p) {
+			int w = cols[p];
+			if (labels[w] == label && level[w] < 0) {
+				level[w] = level[v] + 1;
+				queue.push_back(w);
+			}
+		}
+	}
+	level_start.push_back((int)queue.size());
+	return num_levels;
+}
+
+}  // namespace
+
+SparseCholesky::SparseCholesky() : n_(0), num_entries_(0), perm_(nullptr), inv_perm_(nullptr),
+	c_start_(nullptr), c_rows_(nullptr), c_values_(nullptr), value_map_(nullptr), parent_(nullptr),
+	l_start_(nullptr), l_rows_(nullptr), l_values_(nullptr), l_next_(nullptr), stack_(nullptr),
+	flag_(nullptr), x_(nullptr) {
+}
+
+SparseCholesky::~SparseCholesky() {
+	delete [] perm_;
+	delete [] inv_perm_;
+	delete [] c_start_;
+	delete [] c_rows_;
+	delete [] c_values_;
+	delete [] value_map_;
+	delete [] parent_;
+	delete [] l_start_;
+	delete [] l_rows_;
+	delete [] l_values_;
+	delete [] l_next_;
+	delete [] stack_;
+	delete [] flag_;
+	delete [] x_;
+}
+
+void SparseCholesky::Analyze(int n, const int *row_start, const int *cols) {
+	delete [] perm_;
+	delete [] inv_perm_;
+	delete [] c_start_;
+	delete [] c_rows_;
+	delete [] c_values_;
+	delete [] value_map_;
+	delete [] parent_;
+	delete [] l_start_;
+	delete [] l_rows_;
+	delete [] l_values_;
+	delete [] l_next_;
+	delete [] stack_;
+	delete [] flag_;
+	delete [] x_;
+
+	n_ = n;
+	num_entries_ = row_start[n];
+	perm_ = new int[n_];
+	inv_perm_ = new int[n_];
+	order(row_start, cols);
+
+	// upper triangle of the permuted matrix
+	c_start_ = new int[n_ + 1];
+	std::fill(c_start_, c_start_ + n_ + 1, 0);
+	for (int i = 0; i < n_; ++i) {
+		for (int p = row_start[i]; p < row_start[i + 1]; ++p) {
+			int row = inv_perm_[i];
+			int col = inv_perm_[cols[p]];
+			if (row <= col) {
+				c_start_[col + 1]++;
+			}
+		}
+	}
+	for (int k = 0; k < n_; ++k) {
+		c_start_[k + 1] += c_start_[k];
+	}
+	c_rows_ = new int[c_start_[n_]];
+	c_values_ = new double[c_start_[n_]];
+	value_map_ = new int[num_entries_];
+	std::vector<int> fill(c_start_, c_start_ + n_);
+	for (int i = 0; i < n_; ++i) {
+		for (int p = row_start[i]; p < row_start[i + 1]; ++p) {
+			int row = inv_perm_[i];
+			int col = inv_perm_[cols[p]];
+			if (row <= col) {
+				int slot = fill[col]++;
+				c_rows_[slot] = row;
+				value_map_[p] = slot;
+			} else {
+				value_map_[p] = -1;
+			}
+		}
+	}
+
+	// elimination tree, with path compression through ancestor
+	parent_ = new int[n_];
+	std::vector<int> ancestor(n_);
+	for (int k = 0; k < n_; ++k) {
+		parent_[k] = -1;
+		ancestor[k] = -1;
+		for (int p = c_start_[k]; p < c_start_[k + 1]; ++p) {
+			for (int i = c_rows_[p]; i != -1 && i < k; ) {
+				int next = ancestor[i];
+				ancestor[i] = k;
+				if (next == -1) {
+					parent_[i] = k;
+				}
+				i = next;
+			}
+		}
+	}
+
+	// the pattern of row k of L is the reach of column k in the elimination tree
+	stack_ = new int[n_];
+	flag_ = new int[n_];
+	std::fill(flag_, flag_ + n_, -1);
+	std::vector<int> counts(n_, 1);
+	for (int k = 0; k < n_; ++k) {
+		for (int top = reach(k, stack_); top < n_; ++top) {
+			counts[stack_[top]]++;
+		}
+	}
+	l_start_ = new int[n_ + 1];
+	l_start_[0] = 0;
+	for (int k = 0; k < n_; ++k) {
+		l_start_[k + 1] = l_start_[k] + counts[k];
+	}
+	l_rows_ = new int[l_start_[n_]];
+	l_values_ = new double[l_start_[n_]];
+	l_next_ = new int[n_];
+	x_ = new double[n_];
+	std::fill(x_, x_ + n_, 0.0);
+}
+
+/**
+ * Up-looking factorization: row k of L solves a triangular system with the rows above it, whose
+ * pattern is the reach of column k of A in the elimination tree.
+ */
+bool SparseCholesky::Factor(const double *values) {
+	std::fill(c_values_, c_values_ + c_start_[n_], 0.0);
+	for (int p = 0; p < num_entries_; ++p) {
+		if (value_map_[p] >= 0) {
+			c_values_[value_map_[p]] += values[p];
+		}
+	}
+	std::copy(l_start_, l_start_ + n_, l_next_);
+	std::fill(flag_, flag_ + n_, -1);
+	for (int k = 0; k < n_; ++k) {
+		int top = reach(k, stack_);
+		x_[k] = 0.0;
+		for (int p = c_start_[k]; p < c_start_[k + 1]; ++p) {
+			x_[c_rows_[p]] += c_values_[p];
+		}
+		double d = x_[k];
+		x_[k] = 0.0;
+		for (; top < n_; ++top) {
+			int i = stack_[top];
+			double lki = x_[i] / l_values_[l_start_[i]];
+			x_[i] = 0.0;
+			for (int p = l_start_[i] + 1; p < l_next_[i]; ++p) {
+				x_[l_rows_[p]] -= l_values_[p] * lki;
+			}
+			d -= lki * lki;
+			int p = l_next_[i]++;
+			l_rows_[p] = k;
+			l_values_[p] = lki;
+		}
+		// NaN pivots fail as well
+		if (!(d > 0.0)) {
+			return false;
+		}
+		int p = l_next_[k]++;
+		l_rows_[p] = k;
+		l_values_[p] = std::sqrt(d);
+	}
+	return true;
+}
+
+void SparseCholesky::Solve(double *b, double *work, int num_rhs) const {
+	for (int k = 0; k < n_; ++k) {
+		for (int c = 0; c < num_rhs; ++c) {
+			work[k * num_rhs + c] = b[perm_[k] * num_rhs + c];
+		}
+	}
+	// L y = P b
+	for (int j = 0; j < n_; ++j) {
+		double *y = work + j * num_rhs;
+		double inv_diag = 1.0 / l_values_[l_start_[j]];
+		for (int c = 0; c < num_rhs; ++c) {
+			y[c] *= inv_diag;
+		}
+		for (int p = l_start_[j] + 1; p < l_start_[j + 1]; ++p) {
+			double *row = work + l_rows_[p] * num_rhs;
+			for (int c = 0; c < num_rhs; ++c) {
+				row[c] -= l_values_[p] * y[c];
+			}
+		}
+	}
+	// L^T P x = y
+	for (int j = n_ - 1; j >= 0; --j) {
+		double *x = work + j * num_rhs;
+		for (int p = l_start_[j] + 1; p < l_start_[j + 1]; ++p) {
+			const double *row = work + l_rows_[p] * num_rhs;
+			for (int c = 0; c < num_rhs; ++c) {
+				x[c] -= l_values_[p] * row[c];
+			}
+		}
+		double inv_diag = 1.0 / l_values_[l_start_[j]];
+		for (int c = 0; c < num_rhs; ++c) {
+			x[c] *= inv_diag;
+		}
+	}
+	for (int k = 0; k < n_; ++k) {
+		for (int c = 0; c < num_rhs; ++c) {
+			b[perm_[k] * num_rhs + c] = work[k * num_rhs + c];
+		}
+	}
+}
+
+/**
+ * Nested dissection: a region is split by the middle level of a level structure rooted at a
+ * pseudo-peripheral unknown, both halves are ordered recursively and the separator goes last.
+ * Disconnected regions are split into their components first.
+ */
+void SparseCholesky::order(const int *row_start, const int *cols) {
+	// the regions still to order, perm_[first, last) with labels[] == label
+	struct Region {
+		int first;
+		int last;
+		int label;
+	};
+	std::vector<int> labels(n_, 0);
+	std::vector<int> level(n_, -1);
+	std::vector<int> queue;
+	std::vector<int> level_start;
+	std::vector<int> scratch;
+	std::vector<Region> regions;
+	for (int i = 0; i < n_; ++i) {
+		perm_[i] = i;
+	}
+	if (n_ > 0) {
+		regions.push_back(Region{ 0, n_, 0 });
+	}
+	int num_labels = 1;
+	// the separators are placed from the back, the remaining regions fill the front
+	while (!regions.empty()) {
+		Region region = regions.back();
+		regions.pop_back();
+		int size = region.last - region.first;
+
+		// pseudo-peripheral root: restart from the far end while the structure gets deeper
+		int root = perm_[region.first];
+		int num_levels = levelStructure(root, region.label, row_start, cols, labels.data(), queue, level, level_start);
+		for (int attempt = 0; attempt < 4; ++attempt) {
+			int candidate = queue.back();
+			for (int v : queue) {
+				level[v] = -1;
+			}
+			int candidate_levels = levelStructure(candidate, region.label, row_start, cols, labels.data(),
+				queue, level, level_start);
+			if (candidate_levels <= num_levels) {
+				for (int v : queue) {
+					level[v] = -1;
+				}
+				levelStructure(root, region.label, row_start, cols, labels.data(), queue, level, level_start);
+				break;
+			}
+			root = candidate;
+			num_levels = candidate_levels;
+		}
+
+		if ((int)queue.size() < size) {
+			// the region is disconnected, split off the component of root
+			scratch.assign(perm_ + region.first, perm_ + region.last);
+			int component_label = num_labels++;
+			int rest_label = num_labels++;
+			int front = region.first;
+			int back = region.last;
+			for (int v : scratch) {
+				if (level[v] >= 0) {
+					perm_[front++] = v;
+					labels[v] = component_label;
+				} else {
+					perm_[--back] = v;
+					labels[v] = rest_label;
+				}
+			}
+			for (int v : queue) {
+				level[v] = -1;
+			}
+			regions.push_back(Region{ region.first, front, component_label });
+			regions.push_back(Region{ front, region.last, rest_label });
+			continue;
+		}
+		if (size <= kMinDissectionSize || num_levels < 3) {
+			// small enough to eliminate in level order, which keeps neighbors together
+			std::copy(queue.begin(), queue.end(), perm_ + region.first);
+			for (int v : queue) {
+				level[v] = -1;
+				labels[v] = -1;
+			}
+			continue;
+		}
+
+		int middle = num_levels / 2;
+		int separator_size = level_start[middle + 1] - level_start[middle];
+		int low_label = num_labels++;
+		int high_label = num_labels++;
+		int low_size = level_start[middle];
+		int high_size = size - low_size - separator_size;
+		int *out = perm_ + region.first;
+		int low = 0;
+		int high = low_size;
+		int separator = low_size + high_size;
+		for (int v : queue) {
+			if (level[v] < middle) {
+				out[low++] = v;
+				labels[v] = low_label;
+			} else if (level[v] > middle) {
+				out[high++] = v;
+				labels[v] = high_label;
+			} else {
+				out[separator++] = v;
+				labels[v] = -1;
+			}
+			level[v] = -1;
+		}
+		regions.push_back(Region{ region.first, region.first + low_size, low_label });
+		regions.push_back(Region{ region.first + low_size, region.first + low_size + high_size, high_label });
+	}
+	for (int k = 0; k < n_; ++k) {
+		inv_perm_[perm_[k]] = k;
+	}
+}
+
+/**
+ * Nonzero pattern of row k of L, the unknowns reached from the entries of column k of the
+ * upper triangle by walking up the elimination tree. Written to stack[top, n) in topological
+ * order, top is returned.
+ */
+int SparseCholesky::reach(int k, int *stack) {
+	int top = n_;
+	flag_[k] = k;
+	for (int p = c_start_[k]; p < c_start_[k + 1]; ++p) {
+		int i = c_rows_[p];
+		if (i > k) {
+			continue;
+		}
+		int len = 0;
+		for (; flag_[i] != k; i = parent_[i]) {
+			stack[len++] = i;
+			flag_[i] = k;
+		}
+		while (len > 0) {
+			stack[--top] = stack[--len];
+		}
+	}
+	return top;
+}
@@ -0,0 +1,105 @@
+#include "spring_kernels.h"
+
+#if defined(CLOTHSIM_X86_KERNELS) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+void SpringRunScalar(const SpringRun &run) {
+	springRunRange(run, 0, run.n);
+}
+
+#ifdef CLOTHSIM_X86_KERNELS
+#ifdef _MSC_VER
+/**
+ * Query CPUID and XGETBV directly, the OS must also save the wider registers on a context switch.
+ */
+static SimdLevel detectX86() {
+	int info[4];
+	__cpuid(info, 0);
+	int max_leaf = info[0];
+	if (max_leaf < 1) {
+		return SimdLevel::Scalar;
+	}
+	__cpuid(info, 1);
+	bool sse42 = (info[2] & (1 << 20)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	bool fma = (info[2] & (1 << 12)) != 0;
+	if (!sse42) {
+		return SimdLevel::Scalar;
+	}
+	if (!osxsave || !avx || max_leaf < 7) {
+		return SimdLevel::SSE42;
+	}
+	unsigned long long xcr0 = _xgetbv(0);
+	bool os_avx = (xcr0 & 0x6) == 0x6;
+	bool os_avx512 = (xcr0 & 0xe6) == 0xe6;
+	__cpuidex(info, 7, 0);
+	bool avx2 = (info[1] & (1 << 5)) != 0;
+	bool avx512f = (info[1] & (1 << 16)) != 0;
+	if (os_avx512 && avx512f) {
+		return SimdLevel::AVX512;
+	}
+	if (os_avx && avx2 && fma) {
+		return SimdLevel::AVX2;
+	}
+	return SimdLevel::SSE42;
+}
+#else
+/**
+ * GCC and Clang check the CPUID bits and the OS register support for us.
+ */
+static SimdLevel detectX86() {
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		return SimdLevel::AVX512;
+	}
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		return SimdLevel::AVX2;
+	}
+	if (__builtin_cpu_supports("sse4.2")) {
+		return SimdLevel::SSE42;
+	}
+	return SimdLevel::Scalar;
+}
+#endif  // _MSC_VER
+#endif  // CLOTHSIM_X86_KERNELS
+
+SimdLevel DetectSimdLevel() {
+#ifdef CLOTHSIM_X86_KERNELS
+	static const SimdLevel level = detectX86();
+	return level;
+#else
+	return SimdLevel::Scalar;
+#endif
+}
+
+SpringRunKernel SelectSpringKernel(SimdLevel level) {
+#ifdef CLOTHSIM_X86_KERNELS
+	switch (level) {
+	case SimdLevel::AVX512:
+		return SpringRunAVX512;
+	case SimdLevel::AVX2:
+		return SpringRunAVX2;
+	case SimdLevel::SSE42:
+		return SpringRunSSE42;
+	default:
+		break;
+	}
+#endif
+	return SpringRunScalar;
+}
+
+const char* SimdLevelName(SimdLevel level) {
+	switch (level) {
+	case SimdLevel::SSE42:
+		return "SSE4.2";
+	case SimdLevel::AVX2:
+		return "AVX2";
+	case SimdLevel::AVX512:
+		return "AVX-512";
+	default:
+		return "scalar";
+	}
+}
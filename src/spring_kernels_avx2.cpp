@@ -0,0 +1,36 @@
+#include "spring_kernels.h"
+
+#include <immintrin.h>
+
+/**
+ * 8 springs per iteration with AVX2 and FMA.
+ */
+void SpringRunAVX2(const SpringRun &run) {
+	const __m256 k = _mm256_set1_ps(-run.k);
+	const __m256 kv = _mm256_set1_ps(-run.kv);
+	const __m256 rest = _mm256_set1_ps(run.rest_length);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	int i = 0;
+	for (; i + 8 <= run.n; i += 8) {
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(run.ax + i), _mm256_loadu_ps(run.bx + i));
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(run.ay + i), _mm256_loadu_ps(run.by + i));
+		__m256 dz = _mm256_sub_ps(_mm256_loadu_ps(run.az + i), _mm256_loadu_ps(run.bz + i));
+		__m256 length = _mm256_sqrt_ps(_mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx))));
+		__m256 string_force = _mm256_mul_ps(k, _mm256_sub_ps(length, rest));
+
+		__m256 inv_length = _mm256_div_ps(one, length);
+		dx = _mm256_mul_ps(dx, inv_length);
+		dy = _mm256_mul_ps(dy, inv_length);
+		dz = _mm256_mul_ps(dz, inv_length);
+		__m256 rvx = _mm256_sub_ps(_mm256_loadu_ps(run.vax + i), _mm256_loadu_ps(run.vbx + i));
+		__m256 rvy = _mm256_sub_ps(_mm256_loadu_ps(run.vay + i), _mm256_loadu_ps(run.vby + i));
+		__m256 rvz = _mm256_sub_ps(_mm256_loadu_ps(run.vaz + i), _mm256_loadu_ps(run.vbz + i));
+		__m256 rel_vel = _mm256_fmadd_ps(rvz, dz, _mm256_fmadd_ps(rvy, dy, _mm256_mul_ps(rvx, dx)));
+
+		__m256 force = _mm256_fmadd_ps(kv, rel_vel, string_force);
+		_mm256_storeu_ps(run.fx + i, _mm256_mul_ps(dx, force));
+		_mm256_storeu_ps(run.fy + i, _mm256_mul_ps(dy, force));
+		_mm256_storeu_ps(run.fz + i, _mm256_mul_ps(dz, force));
+	}
+	springRunRange(run, i, run.n);
+}
@@ -0,0 +1,38 @@
+#include "spring_kernels.h"
+
+#include <immintrin.h>
+
+/**
+ * 16 springs per iteration with AVX-512F. The remainder of the run is handled with masked
+ * loads and stores instead of a scalar loop.
+ */
+void SpringRunAVX512(const SpringRun &run) {
+	const __m512 k = _mm512_set1_ps(-run.k);
+	const __m512 kv = _mm512_set1_ps(-run.kv);
+	const __m512 rest = _mm512_set1_ps(run.rest_length);
+	const __m512 one = _mm512_set1_ps(1.0f);
+	for (int i = 0; i < run.n; i += 16) {
+		int remaining = run.n - i;
+		__mmask16 mask = remaining >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << remaining) - 1);
+		__m512 dx = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, run.ax + i), _mm512_maskz_loadu_ps(mask, run.bx + i));
+		__m512 dy = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, run.ay + i), _mm512_maskz_loadu_ps(mask, run.by + i));
+		__m512 dz = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, run.az + i), _mm512_maskz_loadu_ps(mask, run.bz + i));
+		__m512 length = _mm512_sqrt_ps(_mm512_fmadd_ps(dz, dz, _mm512_fmadd_ps(dy, dy, _mm512_mul_ps(dx, dx))));
+		__m512 string_force = _mm512_mul_ps(k, _mm512_sub_ps(length, rest));
+
+		// masked off lanes divide by zero, they are never stored
+		__m512 inv_length = _mm512_div_ps(one, length);
+		dx = _mm512_mul_ps(dx, inv_length);
+		dy = _mm512_mul_ps(dy, inv_length);
+		dz = _mm512_mul_ps(dz, inv_length);
+		__m512 rvx = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, run.vax + i), _mm512_maskz_loadu_ps(mask, run.vbx + i));
+		__m512 rvy = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, run.vay + i), _mm512_maskz_loadu_ps(mask, run.vby + i));
+		__m512 rvz = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, run.vaz + i), _mm512_maskz_loadu_ps(mask, run.vbz + i));
+		__m512 rel_vel = _mm512_fmadd_ps(rvz, dz, _mm512_fmadd_ps(rvy, dy, _mm512_mul_ps(rvx, dx)));
+
+		__m512 force = _mm512_fmadd_ps(kv, rel_vel, string_force);
+		_mm512_mask_storeu_ps(run.fx + i, mask, _mm512_mul_ps(dx, force));
+		_mm512_mask_storeu_ps(run.fy + i, mask, _mm512_mul_ps(dy, force));
+		_mm512_mask_storeu_ps(run.fz + i, mask, _mm512_mul_ps(dz, force));
+	}
+}
@@ -0,0 +1,36 @@
+#include "spring_kernels.h"
+
+#include <nmmintrin.h>
+
+/**
+ * 4 springs per iteration with SSE4.2.
+ */
+void SpringRunSSE42(const SpringRun &run) {
+	const __m128 k = _mm_set1_ps(-run.k);
+	const __m128 kv = _mm_set1_ps(-run.kv);
+	const __m128 rest = _mm_set1_ps(run.rest_length);
+	const __m128 one = _mm_set1_ps(1.0f);
+	int i = 0;
+	for (; i + 4 <= run.n; i += 4) {
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(run.ax + i), _mm_loadu_ps(run.bx + i));
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(run.ay + i), _mm_loadu_ps(run.by + i));
+		__m128 dz = _mm_sub_ps(_mm_loadu_ps(run.az + i), _mm_loadu_ps(run.bz + i));
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+		__m128 string_force = _mm_mul_ps(k, _mm_sub_ps(length, rest));
+
+		__m128 inv_length = _mm_div_ps(one, length);
+		dx = _mm_mul_ps(dx, inv_length);
+		dy = _mm_mul_ps(dy, inv_length);
+		dz = _mm_mul_ps(dz, inv_length);
+		__m128 rvx = _mm_sub_ps(_mm_loadu_ps(run.vax + i), _mm_loadu_ps(run.vbx + i));
+		__m128 rvy = _mm_sub_ps(_mm_loadu_ps(run.vay + i), _mm_loadu_ps(run.vby + i));
+		__m128 rvz = _mm_sub_ps(_mm_loadu_ps(run.vaz + i), _mm_loadu_ps(run.vbz + i));
+		__m128 rel_vel = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rvx, dx), _mm_mul_ps(rvy, dy)), _mm_mul_ps(rvz, dz));
+
+		__m128 force = _mm_add_ps(string_force, _mm_mul_ps(kv, rel_vel));
+		_mm_storeu_ps(run.fx + i, _mm_mul_ps(dx, force));
+		_mm_storeu_ps(run.fy + i, _mm_mul_ps(dy, force));
+		_mm_storeu_ps(run.fz + i, _mm_mul_ps(dz, force));
+	}
+	springRunRange(run, i, run.n);
+}
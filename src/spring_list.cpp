@@ -0,0 +1,23 @@
+#include "spring_list.h"
+
+SpringList::SpringList() : count_(0), a_(nullptr), b_(nullptr), rest_(nullptr) {
+}
+
+SpringList::~SpringList() {
+	delete [] a_;
+	delete [] b_;
+	delete [] rest_;
+}
+
+void SpringList::Resize(int count) {
+	if (count == count_ && a_) {
+		return;
+	}
+	delete [] a_;
+	delete [] b_;
+	delete [] rest_;
+	a_ = new int[count];
+	b_ = new int[count];
+	rest_ = new float[count];
+	count_ = count;
+}
@@ -0,0 +1,77 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(int num_threads) : num_threads_(num_threads < 1 ? 1 : num_threads), generation_(0),
+	pending_(0), stop_(false), task_(nullptr), task_fn_(nullptr), begin_(0), end_(0) {
+	for (int i = 1; i < num_threads_; ++i) {
+		workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	start_cv_.notify_all();
+	for (std::thread &worker : workers_) {
+		worker.join();
+	}
+}
+
+/**
+ * The range [first, last) handled by the given thread for the current loop.
+ */
+void ThreadPool::chunk(int thread, int *first, int *last) const {
+	int count = end_ - begin_;
+	*first = begin_ + (int)((long long)count * thread / num_threads_);
+	*last = begin_ + (int)((long long)count * (thread + 1) / num_threads_);
+}
+
+void ThreadPool::run(int begin, int end, Task task, const void *fn) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		task_ = task;
+		task_fn_ = fn;
+		begin_ = begin;
+		end_ = end;
+		pending_ = num_threads_ - 1;
+		++generation_;
+	}
+	start_cv_.notify_all();
+
+	int first, last;
+	chunk(0, &first, &last);
+	if (first < last) {
+		task(fn, first, last, 0);
+	}
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	done_cv_.wait(lock, [this] { return pending_ == 0; });
+}
+
+void ThreadPool::workerLoop(int thread) {
+	unsigned long seen_generation = 0;
+	while (true) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		start_cv_.wait(lock, [&] { return stop_ || generation_ != seen_generation; });
+		if (stop_) {
+			return;
+		}
+		seen_generation = generation_;
+		int first, last;
+		chunk(thread, &first, &last);
+		Task task = task_;
+		const void *fn = task_fn_;
+		lock.unlock();
+
+		if (first < last) {
+			task(fn, first, last, thread);
+		}
+
+		lock.lock();
+		if (--pending_ == 0) {
+			lock.unlock();
+			done_cv_.notify_one();
+		}
+	}
+}
@@ -0,0 +1,115 @@
+#include "vertex_order.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Bits per axis of the quantized coordinates, three axes fill a 30 bit key
+static const int kCurveBits = 10;
+
+const char* VertexOrderName(VertexOrder order) {
+	switch (order) {
+	case VertexOrder::Morton:
+		return "Morton";
+	case VertexOrder::Hilbert:
+		return "Hilbert";
+	default:
+		return "input";
+	}
+}
+
+/**
+ * Spread the low 10 bits of v so there are two zero bits between each of them.
+ */
+static uint32_t spreadBits(uint32_t v) {
+	v &= 0x3ff;
+	v = (v | (v << 16)) & 0x030000ff;
+	v = (v | (v << 8)) & 0x0300f00f;
+	v = (v | (v << 4)) & 0x030c30c3;
+	v = (v | (v << 2)) & 0x09249249;
+	return v;
+}
+
+static uint32_t mortonKey(const uint32_t axes[3]) {
+	return (spreadBits(axes[0]) << 2) | (spreadBits(axes[1]) << 1) | spreadBits(axes[2]);
+}
+
+/**
+ * Position along the Hilbert curve, using Skilling's transform from the axes to the transposed
+ * Hilbert index ("Programming the Hilbert curve", 2004).
+ */
+static uint32_t hilbertKey(const uint32_t axes[3]) {
+	uint32_t x[3] = { axes[0], axes[1], axes[2] };
+	const uint32_t m = 1u << (kCurveBits - 1);
+	// inverse undo
+	for (uint32_t q = m; q > 1; q >>= 1) {
+		uint32_t p = q - 1;
+		for (int i = 0; i < 3; ++i) {
+			if (x[i] & q) {
+				x[0] ^= p;
+			} else {
+				uint32_t t = (x[0] ^ x[i]) & p;
+				x[0] ^= t;
+				x[i] ^= t;
+			}
+		}
+	}
+	// gray encode
+	x[1] ^= x[0];
+	x[2] ^= x[1];
+	uint32_t t = 0;
+	for (uint32_t q = m; q > 1; q >>= 1) {
+		if (x[2] & q) {
+			t ^= q - 1;
+		}
+	}
+	for (int i = 0; i < 3; ++i) {
+		x[i] ^= t;
+	}
+	// interleave the transposed index, most significant bits first
+	uint32_t key = 0;
+	for (int b = kCurveBits - 1; b >= 0; --b) {
+		for (int i = 0; i < 3; ++i) {
+			key = (key << 1) | ((x[i] >> b) & 1);
+		}
+	}
+	return key;
+}
+
+void SpaceFillingCurveOrder(const glm::vec3 *points, int num_pts, VertexOrder order, int *new_index) {
+	if (order == VertexOrder::Input || num_pts == 0) {
+		for (int i = 0; i < num_pts; ++i) {
+			new_index[i] = i;
+		}
+		return;
+	}
+	glm::vec3 lower = points[0];
+	glm::vec3 upper = points[0];
+	for (int i = 1; i < num_pts; ++i) {
+		lower = glm::min(lower, points[i]);
+		upper = glm::max(upper, points[i]);
+	}
+	// a flat cloth has no extent along one axis, all of its points get 0 there
+	glm::vec3 extent = upper - lower;
+	const float cells = (float)((1 << kCurveBits) - 1);
+	glm::vec3 scale;
+	for (int c = 0; c < 3; ++c) {
+		scale[c] = extent[c] > 0.0f ? cells / extent[c] : 0.0f;
+	}
+
+	std::vector<uint64_t> keys(num_pts);
+	for (int i = 0; i < num_pts; ++i) {
+		glm::vec3 cell = (points[i] - lower) * scale;
+		uint32_t axes[3];
+		for (int c = 0; c < 3; ++c) {
+			axes[c] = (uint32_t)std::min(std::max(cell[c], 0.0f), cells);
+		}
+		uint32_t key = order == VertexOrder::Morton ? mortonKey(axes) : hilbertKey(axes);
+		// the input index breaks ties, so the sort is stable
+		keys[i] = ((uint64_t)key << 32) | (uint32_t)i;
+	}
+	std::sort(keys.begin(), keys.end());
+	for (int i = 0; i < num_pts; ++i) {
+		new_index[(uint32_t)keys[i]] = i;
+	}
+}
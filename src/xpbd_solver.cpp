@@ -0,0 +1,139 @@
+#include "xpbd_solver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+XpbdSolver::XpbdSolver() : num_pts_(0), num_iterations_(10), num_constraints_(0), num_colors_(0),
+	color_start_(nullptr), constraint_a_(nullptr), constraint_b_(nullptr), constraint_rest_(nullptr),
+	lambda_(nullptr) {
+}
+
+XpbdSolver::~XpbdSolver() {
+	delete [] color_start_;
+	delete [] constraint_a_;
+	delete [] constraint_b_;
+	delete [] constraint_rest_;
+	delete [] lambda_;
+}
+
+/**
+ * Color the constraints greedily, every constraint takes the lowest color none of the
+ * constraints at its end points has yet, and store them grouped by color.
+ */
+void XpbdSolver::Setup(int num_pts, const SpringList &springs) {
+	num_pts_ = num_pts;
+	num_constraints_ = springs.Size();
+	const int *spring_a = springs.A();
+	const int *spring_b = springs.B();
+
+	// colors already taken at each point
+	std::vector<std::vector<int>> point_colors(num_pts_);
+	std::vector<int> color(num_constraints_);
+	num_colors_ = 0;
+	for (int s = 0; s < num_constraints_; ++s) {
+		const std::vector<int> &taken_a = point_colors[spring_a[s]];
+		const std::vector<int> &taken_b = point_colors[spring_b[s]];
+		int c = 0;
+		while (std::find(taken_a.begin(), taken_a.end(), c) != taken_a.end() ||
+			std::find(taken_b.begin(), taken_b.end(), c) != taken_b.end()) {
+			++c;
+		}
+		color[s] = c;
+		point_colors[spring_a[s]].push_back(c);
+		point_colors[spring_b[s]].push_back(c);
+		num_colors_ = std::max(num_colors_, c + 1);
+	}
+
+	delete [] color_start_;
+	delete [] constraint_a_;
+	delete [] constraint_b_;
+	delete [] constraint_rest_;
+	delete [] lambda_;
+	color_start_ = new int[num_colors_ + 1];
+	constraint_a_ = new int[num_constraints_];
+	constraint_b_ = new int[num_constraints_];
+	constraint_rest_ = new float[num_constraints_];
+	lambda_ = new float[num_constraints_];
+
+	std::fill(color_start_, color_start_ + num_colors_ + 1, 0);
+	for (int s = 0; s < num_constraints_; ++s) {
+		color_start_[color[s] + 1]++;
+	}
+	for (int c = 0; c < num_colors_; ++c) {
+		color_start_[c + 1] += color_start_[c];
+	}
+	// keep the spring order within each color, it is the memory order of the points
+	std::vector<int> fill(color_start_, color_start_ + num_colors_);
+	for (int s = 0; s < num_constraints_; ++s) {
+		int slot = fill[color[s]]++;
+		constraint_a_[slot] = spring_a[s];
+		constraint_b_[slot] = spring_b[s];
+		constraint_rest_[slot] = springs.Rest()[s];
+	}
+	prev_pos_.Resize(num_pts_);
+}
+
+void XpbdSolver::Step(Vec3Lanes &pos, Vec3Lanes &vel, const Vec3Lanes &forces, const float *inv_mass,
+	float k, float kv, float h, ThreadPool &pool) {
+	Vec3Lanes &prev_pos = prev_pos_.Lanes();
+
+	// predict the positions from the external forces alone
+	pool.ParallelFor(0, num_pts_, [&](int first, int last, int) {
+		for (int i = first; i < last; ++i) {
+			prev_pos.Set(i, pos.Get(i));
+			float scale = h * inv_mass[i];
+			vel.x[i] += forces.x[i] * scale;
+			vel.y[i] += forces.y[i] * scale;
+			vel.z[i] += forces.z[i] * scale;
+			pos.x[i] += vel.x[i] * h;
+			pos.y[i] += vel.y[i] * h;
+			pos.z[i] += vel.z[i] * h;
+		}
+	});
+	std::fill(lambda_, lambda_ + num_constraints_, 0.0f);
+
+	// time scaled compliance and damping, alpha~ = alpha / h^2 and gamma = alpha~ beta~ / h
+	// with the damping beta~ = h^2 kv. Without stiffness there is no spring force, the points
+	// just follow the prediction, a zero compliance would make every spring rigid instead.
+	bool project = k > 0.0f;
+	float alpha = project ? 1.0f / (k * h * h) : 0.0f;
+	float gamma = project ? kv / (k * h) : 0.0f;
+	for (int iteration = 0; project && iteration < num_iterations_; ++iteration) {
+		for (int c = 0; c < num_colors_; ++c) {
+			pool.ParallelFor(color_start_[c], color_start_[c + 1], [&](int first, int last, int) {
+				for (int s = first; s < last; ++s) {
+					int a = constraint_a_[s];
+					int b = constraint_b_[s];
+					float w = inv_mass[a] + inv_mass[b];
+					if (w == 0.0f) {
+						continue;
+					}
+					glm::vec3 dir = pos.Get(a) - pos.Get(b);
+					float length = glm::length(dir);
+					if (length == 0.0f) {
+						continue;
+					}
+					glm::vec3 n = dir / length;
+					float constraint = length - constraint_rest_[s];
+					// rate of change of the constraint over the step, for the damping
+					float motion = glm::dot(n, (pos.Get(a) - prev_pos.Get(a)) - (pos.Get(b) - prev_pos.Get(b)));
+					float d_lambda = (-constraint - alpha * lambda_[s] - gamma * motion) / ((1.0f + gamma) * w + alpha);
+					lambda_[s] += d_lambda;
+					pos.Set(a, pos.Get(a) + (inv_mass[a] * d_lambda) * n);
+					pos.Set(b, pos.Get(b) - (inv_mass[b] * d_lambda) * n);
+				}
+			});
+		}
+	}
+
+	// the velocities follow from the corrected positions
+	float inv_h = 1.0f / h;
+	pool.ParallelFor(0, num_pts_, [&](int first, int last, int) {
+		for (int i = first; i < last; ++i) {
+			vel.Set(i, (pos.Get(i) - prev_pos.Get(i)) * inv_h);
+		}
+	});
+}
@@ -0,0 +1,38 @@
+#include <cstring>
+#include <iostream>
+
+#include "tests.h"
+
+struct TestCase {
+	const char *name;
+	int (*run)();
+};
+
+static const TestCase kTests[] = {
+	{ "step_allocations", StepAllocationsTest },
+	{ "spring_kernels", SpringKernelsTest },
+	{ "force_modes", ForceModesTest },
+	{ "grid_cloth", GridClothTest },
+};
+
+/**
+ * Usage: clothsim_tests [name]
+ * Runs the named check, or every check without a name, and exits with the number of failed cases.
+ */
+int main(int argc, char* argv[]) {
+	int failures = 0;
+	bool found = false;
+	for (const TestCase &test : kTests) {
+		if (argc > 1 && std::strcmp(argv[1], test.name) != 0) {
+			continue;
+		}
+		found = true;
+		std::cout << "== " << test.name << std::endl;
+		failures += test.run();
+	}
+	if (!found) {
+		std::cout << "unknown check " << argv[1] << std::endl;
+		return 1;
+	}
+	return failures;
+}
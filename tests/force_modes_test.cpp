@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+#include "tests.h"
+
+/**
+ * Checks that the force modes and the tiled traversal agree with ForceMode::Scatter on a single
+ * thread. The modes add up the spring forces of a point in a different order, so they only
+ * agree up to rounding. ForceMode::Fused runs the same arithmetic as ForceMode::Gather and must
+ * match it exactly for any thread count, which relies on ThreadPool::ParallelFor() splitting the
+ * ropes the same way in both of its passes.
+ */
+
+static const int kNumRopes = 40;
+static const int kPointsPerRope = 45;
+static const int kNumSteps = 100;
+// largest difference allowed between the positions after kNumSteps steps
+static const float kTolerance = 1e-4f;
+
+static void hangCloth(Cloth &cloth) {
+	for (int i = 0; i < cloth.NumRopes(); ++i) {
+		cloth.LockNode(i, 0, true);
+	}
+	for (int i = 0; i < kNumSteps; ++i) {
+		cloth.Update(0.1f);
+	}
+}
+
+static float maxDifference(const Cloth &a, const Cloth &b) {
+	float max_difference = 0.f;
+	for (int i = 0; i < a.NumPoints(); ++i) {
+		max_difference = std::max(max_difference, glm::length(a.Positions()[i] - b.Positions()[i]));
+	}
+	return max_difference;
+}
+
+/**
+ * Step a cloth in the given mode and compare it with the reference. A tile_size of 0 keeps whole
+ * ropes, Cloth::SetTileSize() rounds the others down to whole lanes.
+ */
+static bool checkMode(const Cloth &reference, ForceMode mode, int num_threads, int tile_size) {
+	Cloth cloth(kNumRopes, kPointsPerRope, 6.5f, 2.25f, 0.75f, 1.f, 1.5f, -5.f, 24.f, 5.f, mode);
+	cloth.SetThreadCount(num_threads);
+	cloth.SetTileSize(tile_size > 0 ? tile_size : 2 * kPointsPerRope);
+	hangCloth(cloth);
+	float difference = maxDifference(cloth, reference);
+	bool ok = difference <= kTolerance;
+	std::cout << (ok ? "ok   " : "FAIL ") << ForceModeName(mode) << ", " << num_threads << " threads, tile "
+		<< (tile_size > 0 ? std::to_string(cloth.GetTileSize()) : std::string("off")) << ": within " << difference
+		<< " of scatter" << std::endl;
+	return ok;
+}
+
+static bool checkFused(int num_threads) {
+	Cloth gather(kNumRopes, kPointsPerRope, 6.5f, 2.25f, 0.75f, 1.f, 1.5f, -5.f, 24.f, 5.f, ForceMode::Gather);
+	Cloth fused(kNumRopes, kPointsPerRope, 6.5f, 2.25f, 0.75f, 1.f, 1.5f, -5.f, 24.f, 5.f, ForceMode::Fused);
+	gather.SetThreadCount(num_threads);
+	fused.SetThreadCount(num_threads);
+	hangCloth(gather);
+	hangCloth(fused);
+	int num_different = 0;
+	for (int i = 0; i < gather.NumPoints(); ++i) {
+		const glm::vec3 &a = gather.Positions()[i];
+		const glm::vec3 &b = fused.Positions()[i];
+		if (a.x != b.x || a.y != b.y || a.z != b.z) {
+			num_different++;
+		}
+	}
+	bool ok = num_different == 0;
+	std::cout << (ok ? "ok   " : "FAIL ") << "fused, " << num_threads << " threads: " << num_different
+		<< " points differ from gather" << std::endl;
+	return ok;
+}
+
+int ForceModesTest() {
+	Cloth reference(kNumRopes, kPointsPerRope, 6.5f, 2.25f, 0.75f, 1.f, 1.5f, -5.f, 24.f, 5.f);
+	hangCloth(reference);
+
+	int failures = 0;
+	for (int num_threads : { 1, 3, 4 }) {
+		failures += checkMode(reference, ForceMode::Gather, num_threads, 0) ? 0 : 1;
+		// ropes split into segments of 16 points, the last one shorter
+		failures += checkMode(reference, ForceMode::Gather, num_threads, 16) ? 0 : 1;
+		failures += checkFused(num_threads) ? 0 : 1;
+	}
+	return failures;
+}
@@ -0,0 +1,63 @@
+#include <algorithm>
+#include <iostream>
+
+#include "grid_cloth.h"
+#include "tests.h"
+
+/**
+ * Checks that a GridCloth steps and shades like a runtime sized Cloth of the same size and
+ * force mode, with the SIMD spring kernel and with its own fixed size kernel at
+ * SimdLevel::Scalar. Ropes of 45 points give runs of 45 and 44 springs, neither a multiple of
+ * a vector width.
+ */
+
+static const int kNumRopes = 40;
+static const int kPointsPerRope = 45;
+static const int kNumSteps = 100;
+// largest difference allowed between the positions, and between the normals, after kNumSteps steps
+static const float kTolerance = 1e-4f;
+
+static void hangCloth(Cloth &cloth, SimdLevel level, int num_threads) {
+	cloth.SetSimdLevel(level);
+	cloth.SetThreadCount(num_threads);
+	for (int i = 0; i < cloth.NumRopes(); ++i) {
+		cloth.LockNode(i, 0, true);
+	}
+	for (int i = 0; i < kNumSteps; ++i) {
+		cloth.Update(0.1f);
+	}
+}
+
+static bool checkGrid(ForceMode mode, SimdLevel level, int num_threads) {
+	Cloth cloth(kNumRopes, kPointsPerRope, 6.5f, 2.25f, 0.75f, 1.f, 1.5f, -5.f, 24.f, 5.f, mode);
+	GridCloth<kNumRopes, kPointsPerRope> grid(6.5f, 2.25f, 0.75f, 1.f, 1.5f, -5.f, 24.f, 5.f, mode);
+	hangCloth(cloth, level, num_threads);
+	hangCloth(grid, level, num_threads);
+	float position_difference = 0.f;
+	float normal_difference = 0.f;
+	for (int i = 0; i < cloth.NumPoints(); ++i) {
+		position_difference = std::max(position_difference, glm::length(cloth.Positions()[i] - grid.Positions()[i]));
+		normal_difference = std::max(normal_difference, glm::length(cloth.Normals()[i] - grid.Normals()[i]));
+	}
+	bool ok = position_difference <= kTolerance && normal_difference <= kTolerance;
+	std::cout << (ok ? "ok   " : "FAIL ") << ForceModeName(mode) << ", " << SimdLevelName(grid.GetSimdLevel())
+		<< ", " << num_threads << " threads: positions within " << position_difference << ", normals within "
+		<< normal_difference << " of Cloth" << std::endl;
+	return ok;
+}
+
+int GridClothTest() {
+	int failures = 0;
+	const ForceMode modes[] = { ForceMode::Gather, ForceMode::Fused };
+	for (ForceMode mode : modes) {
+		for (SimdLevel level : { DetectSimdLevel(), SimdLevel::Scalar }) {
+			for (int num_threads : { 1, 3 }) {
+				failures += checkGrid(mode, level, num_threads) ? 0 : 1;
+			}
+			if (level == SimdLevel::Scalar) {
+				break;
+			}
+		}
+	}
+	return failures;
+}
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "spring_kernels.h"
+#include "tests.h"
+
+/**
+ * Checks every vector kernel this CPU supports against SpringRunScalar(), on single runs whose
+ * lengths are not a multiple of any vector width so the remainder loops are covered, and on a
+ * cloth stepped with each kernel.
+ */
+
+// largest difference allowed between a vector kernel and the reference, relative to the force
+static const float kForceTolerance = 2e-5f;
+// largest difference allowed between the positions after kClothSteps steps, the rounding
+// differences of the single runs grow over the steps to about 2e-5
+static const float kPositionTolerance = 1e-4f;
+static const int kClothSteps = 300;
+
+/**
+ * The inputs and outputs of one spring run, a points are near b points at about the rest length.
+ */
+struct RunData {
+	std::vector<float> a[3], b[3], va[3], vb[3], f[3];
+
+	RunData(int n, std::mt19937 &rng) {
+		std::uniform_real_distribution<float> offset(-1.f, 1.f);
+		std::uniform_real_distribution<float> pos(-10.f, 10.f);
+		for (int c = 0; c < 3; ++c) {
+			a[c].resize(n);
+			b[c].resize(n);
+			va[c].resize(n);
+			vb[c].resize(n);
+			f[c].assign(n, 0.f);
+			for (int i = 0; i < n; ++i) {
+				a[c][i] = pos(rng);
+				b[c][i] = a[c][i] + offset(rng);
+				va[c][i] = 5.f * offset(rng);
+				vb[c][i] = 5.f * offset(rng);
+			}
+		}
+	}
+
+	SpringRun Run() {
+		SpringRun run;
+		run.ax = a[0].data(); run.ay = a[1].data(); run.az = a[2].data();
+		run.bx = b[0].data(); run.by = b[1].data(); run.bz = b[2].data();
+		run.vax = va[0].data(); run.vay = va[1].data(); run.vaz = va[2].data();
+		run.vbx = vb[0].data(); run.vby = vb[1].data(); run.vbz = vb[2].data();
+		run.fx = f[0].data(); run.fy = f[1].data(); run.fz = f[2].data();
+		run.n = (int)a[0].size();
+		run.k = 6.5f;
+		run.kv = 2.25f;
+		run.rest_length = 1.f;
+		return run;
+	}
+};
+
+static bool checkRuns(SimdLevel level) {
+	const int lengths[] = { 1, 3, 5, 7, 13, 31, 37, 63, 255 };
+	SpringRunKernel kernel = SelectSpringKernel(level);
+	std::mt19937 rng(1);
+	float max_error = 0.f;
+	for (int n : lengths) {
+		RunData data(n, rng);
+		std::vector<float> expected[3];
+		SpringRun run = data.Run();
+		SpringRunScalar(run);
+		for (int c = 0; c < 3; ++c) {
+			expected[c] = data.f[c];
+			std::fill(data.f[c].begin(), data.f[c].end(), 0.f);
+		}
+		kernel(run);
+		for (int c = 0; c < 3; ++c) {
+			for (int i = 0; i < n; ++i) {
+				float error = std::abs(data.f[c][i] - expected[c][i]) / std::max(1.f, std::abs(expected[c][i]));
+				max_error = std::max(max_error, error);
+			}
+		}
+	}
+	bool ok = max_error <= kForceTolerance;
+	std::cout << (ok ? "ok   " : "FAIL ") << SimdLevelName(level) << " runs: relative error " << max_error << std::endl;
+	return ok;
+}
+
+static void hangCloth(Cloth &cloth) {
+	for (int i = 0; i < cloth.NumRopes(); ++i) {
+		cloth.LockNode(i, 0, true);
+	}
+	for (int i = 0; i < kClothSteps; ++i) {
+		cloth.Update(0.1f);
+	}
+}
+
+static bool checkCloth(SimdLevel level, const Cloth &reference) {
+	// ropes of 45 points, runs of 45 and 44 springs
+	Cloth cloth(40, 45, 6.5f, 2.25f, 0.75f, 1.f, 1.5f, -5.f, 24.f, 5.f);
+	cloth.SetSimdLevel(level);
+	hangCloth(cloth);
+	float max_error = 0.f;
+	for (int i = 0; i < cloth.NumPoints(); ++i) {
+		max_error = std::max(max_error, glm::length(cloth.Positions()[i] - reference.Positions()[i]));
+	}
+	bool ok = max_error <= kPositionTolerance;
+	std::cout << (ok ? "ok   " : "FAIL ") << SimdLevelName(level) << " cloth: " << kClothSteps << " steps within "
+		<< max_error << std::endl;
+	return ok;
+}
+
+int SpringKernelsTest() {
+	Cloth reference(40, 45, 6.5f, 2.25f, 0.75f, 1.f, 1.5f, -5.f, 24.f, 5.f);
+	reference.SetSimdLevel(SimdLevel::Scalar);
+	hangCloth(reference);
+
+	int failures = 0;
+	const SimdLevel levels[] = { SimdLevel::SSE42, SimdLevel::AVX2, SimdLevel::AVX512 };
+	for (SimdLevel level : levels) {
+		if (level > DetectSimdLevel()) {
+			std::cout << "skip " << SimdLevelName(level) << ", not supported here" << std::endl;
+			continue;
+		}
+		failures += checkRuns(level) ? 0 : 1;
+		failures += checkCloth(level, reference) ? 0 : 1;
+	}
+	return failures;
+}
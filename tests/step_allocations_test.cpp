@@ -0,0 +1,54 @@
+#include <iostream>
+#include <memory>
+
+#include "alloc_counter.h"
+#include "tests.h"
+
+/**
+ * Checks that a warmed up Cloth::Update() makes no heap allocations, see ClothStats. Built
+ * against a copy of the library configured with CLOTHSIM_COUNT_ALLOCATIONS.
+ */
+
+static bool checkSteadyState(ForceMode mode, int num_threads) {
+	const int size = 64;
+	Cloth cloth(size, size, 6.5f, 2.25f, 0.75f, 1.f, 1.5f, -5.f, 24.f, 5.f, mode);
+	cloth.SetThreadCount(num_threads);
+	for (int i = 0; i < size; ++i) {
+		cloth.LockNode(i, 0, true);
+	}
+	// the first steps size the workspace
+	const int warm_up_steps = 3;
+	for (int i = 0; i < warm_up_steps; ++i) {
+		cloth.Update(0.1f);
+	}
+	const int num_steps = 10;
+	for (int i = 0; i < num_steps; ++i) {
+		cloth.Update(0.1f);
+		if (cloth.Stats().step_allocations != 0) {
+			std::cout << "FAIL " << ForceModeName(mode) << ", " << num_threads << " threads: step " << i << " made "
+				<< cloth.Stats().step_allocations << " allocations" << std::endl;
+			return false;
+		}
+	}
+	std::cout << "ok   " << ForceModeName(mode) << ", " << num_threads << " threads" << std::endl;
+	return true;
+}
+
+int StepAllocationsTest() {
+	// make sure the counting is compiled in, otherwise every check would pass trivially
+	size_t before = HeapAllocationCount();
+	std::unique_ptr<int> probe(new int(0));
+	if (HeapAllocationCount() == before) {
+		std::cout << "FAIL heap allocations are not counted, build with CLOTHSIM_COUNT_ALLOCATIONS" << std::endl;
+		return 1;
+	}
+
+	int failures = 0;
+	const ForceMode modes[] = { ForceMode::Scatter, ForceMode::Gather, ForceMode::Fused };
+	for (ForceMode mode : modes) {
+		for (int num_threads : { 1, 4 }) {
+			failures += checkSteadyState(mode, num_threads) ? 0 : 1;
+		}
+	}
+	return failures;
+}
@@ -0,0 +1,26 @@
+#ifndef CLOTHSIM_TESTS_H
+#define CLOTHSIM_TESTS_H
+
+#include "cloth.h"
+
+/**
+ * The checks run by clothsim_tests, see tests/clothsim_tests.cpp. Each one prints a line per case
+ * and returns the number of failed cases.
+ */
+int StepAllocationsTest();
+int SpringKernelsTest();
+int ForceModesTest();
+int GridClothTest();
+
+inline const char* ForceModeName(ForceMode mode) {
+	switch (mode) {
+	case ForceMode::Gather:
+		return "gather";
+	case ForceMode::Fused:
+		return "fused";
+	default:
+		return "scatter";
+	}
+}
+
+#endif  // CLOTHSIM_TESTS_H